@@ -0,0 +1,208 @@
+/*
+* 
+* Copyright (c) 2012, Ban the Rewind
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+/*
+* Console benchmarks for MeshHelper. Build in Release and run from a 
+* terminal. Each benchmark prints a table of the best of several runs.
+*/
+
+#include "cinder/Thread.h"
+#include "cinder/Timer.h"
+#include "cinder/TriMesh.h"
+#include "MeshHelper.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace ci;
+using namespace std;
+
+namespace
+{
+
+// The sphere generator as it was before the rewrite, kept to measure 
+// against. It pushes six indices for every segment of every ring, some 
+// pointing past the last ring, then drops those with erase() in a loop.
+TriMesh createSphereTriMeshErase( uint32_t segments )
+{
+	vector<uint32_t> indices;
+	vector<Vec3f> normals;
+	vector<Vec3f> positions;
+	vector<Vec2f> texCoords;
+
+	uint32_t layers = segments / 2;
+	float step = (float)M_PI / (float)layers;
+	float delta = ((float)M_PI * 2.0f) / (float)segments;
+
+	uint32_t p = 0;
+	for ( float phi = 0.0f; p <= layers; p++, phi += step ) {
+		uint32_t t = 0;
+		for ( float theta = delta; t < segments; t++, theta += delta ) {
+			float sinP = math<float>::sin( phi );
+			Vec3f position(
+				sinP * math<float>::cos( theta ),
+				sinP * math<float>::sin( theta ),
+				-math<float>::cos( phi ) );
+			positions.push_back(position);
+
+			Vec3f normal = position.normalized();
+			normals.push_back( normal );
+
+			texCoords.push_back( ( normal.xy() + Vec2f::one() ) * 0.5f ); 
+
+			uint32_t n = t + 1 >= segments ? 0 : t + 1;
+			indices.push_back( p * segments + t );
+			indices.push_back( ( p + 1 ) * segments + t );
+			indices.push_back( p * segments + n );
+			indices.push_back( p * segments + n );
+			indices.push_back( ( p + 1 ) * segments + t );
+			indices.push_back( ( p + 1 ) * segments + n );
+		}
+	}
+
+	for ( vector<uint32_t>::iterator iter = indices.begin(); iter != indices.end(); ) {
+		if ( *iter < positions.size() ) {
+			++iter;
+		} else {
+			iter = indices.erase( iter );
+		}
+	}
+
+	return MeshHelper::createTriMesh( indices, positions, normals, texCoords );
+}
+
+TriMesh createSphereTriMesh( uint32_t segments )
+{
+	return MeshHelper::createSphereTriMesh( segments );
+}
+
+// Best time in milliseconds of runs calls to create( segments ), and the triangle count
+double timeBest( TriMesh ( *create )( uint32_t ), uint32_t segments, uint32_t runs, size_t *numTriangles )
+{
+	double best = 0.0;
+	for ( uint32_t r = 0; r < runs; r++ ) {
+		Timer timer( true );
+		TriMesh mesh = create( segments );
+		timer.stop();
+		*numTriangles	= mesh.getNumTriangles();
+		double ms		= timer.getSeconds() * 1000.0;
+		best			= r == 0 ? ms : std::min( best, ms );
+	}
+	return best;
+}
+
+// Times the current sphere generator against the erase loop it replaced
+void benchmarkSphere()
+{
+	static const uint32_t kSegments[]	= { 64, 256, 1024 };
+	static const uint32_t kRuns			= 5;
+
+	printf( "Sphere: erase loop vs. exact generator, best of %u runs\n", kRuns );
+	printf( "%10s %12s %12s %10s %12s %12s\n", "segments", "erase (ms)", "exact (ms)", "speedup", 
+		"erase tris", "exact tris" );
+	for ( size_t i = 0; i < sizeof( kSegments ) / sizeof( kSegments[ 0 ] ); i++ ) {
+		size_t eraseTriangles	= 0;
+		size_t exactTriangles	= 0;
+		double erase			= timeBest( createSphereTriMeshErase, kSegments[ i ], kRuns, &eraseTriangles );
+		double exact			= timeBest( createSphereTriMesh, kSegments[ i ], kRuns, &exactTriangles );
+		printf( "%10u %12.3f %12.3f %9.1fx %12u %12u\n", kSegments[ i ], erase, exact, erase / exact, 
+			(uint32_t)eraseTriangles, (uint32_t)exactTriangles );
+	}
+	printf( "\n" );
+}
+
+// Returns true if both vectors hold the same bytes
+template<typename T>
+bool isIdentical( const vector<T> &a, const vector<T> &b )
+{
+	return a.size() == b.size() && ( a.empty() || memcmp( &a[ 0 ], &b[ 0 ], a.size() * sizeof( T ) ) == 0 );
+}
+
+bool isIdentical( const TriMesh &a, const TriMesh &b )
+{
+	return isIdentical( a.getIndices(), b.getIndices() ) && isIdentical( a.getVertices(), b.getVertices() ) && 
+		isIdentical( a.getNormals(), b.getNormals() ) && isIdentical( a.getTexCoords(), b.getTexCoords() );
+}
+
+// Times a size x size plane on one to maxThreads threads, checking each 
+// result against the single threaded one
+void benchmarkPlane( uint32_t size, uint32_t maxThreads )
+{
+	static const uint32_t kRuns = 3;
+
+	printf( "Plane: %u x %u vertices on 1 to %u threads, best of %u runs\n", size, size, maxThreads, kRuns );
+	printf( "%10s %12s %10s %10s\n", "threads", "time (ms)", "speedup", "identical" );
+	TriMesh reference;
+	double single = 0.0;
+	for ( uint32_t n = 1; n <= maxThreads; n++ ) {
+		double best = 0.0;
+		bool identical = true;
+		for ( uint32_t r = 0; r < kRuns; r++ ) {
+			Timer timer( true );
+			TriMesh mesh = MeshHelper::createPlaneTriMesh( size, size, n );
+			timer.stop();
+			double ms	= timer.getSeconds() * 1000.0;
+			best		= r == 0 ? ms : std::min( best, ms );
+			if ( n == 1 && r == 0 ) {
+				reference = mesh;
+			} else {
+				identical = identical && isIdentical( mesh, reference );
+			}
+		}
+		if ( n == 1 ) {
+			single = best;
+		}
+		printf( "%10u %12.3f %9.2fx %10s\n", n, best, single / best, identical ? "yes" : "NO" );
+	}
+	printf( "\n" );
+}
+
+}
+
+// Usage: Benchmark [max threads] [plane size]
+// Threads default to one per core and the plane to 4096 x 4096 vertices, 
+// which needs around 2 GB for the mesh and its reference copy.
+int main( int argc, char *argv[] )
+{
+	uint32_t maxThreads	= argc > 1 ? (uint32_t)atoi( argv[ 1 ] ) : thread::hardware_concurrency();
+	uint32_t planeSize	= argc > 2 ? (uint32_t)atoi( argv[ 2 ] ) : 4096;
+	maxThreads			= std::max<uint32_t>( maxThreads, 1 );
+
+	benchmarkSphere();
+	benchmarkPlane( planeSize, maxThreads );
+	return 0;
+}
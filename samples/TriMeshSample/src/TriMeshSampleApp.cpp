@@ -85,6 +85,10 @@ private:
 	int32_t						mNumSegments;
 	int32_t						mNumSegmentsPrev;
 
+	// Number of threads used to generate the plane, zero for one per core
+	int32_t						mNumThreads;
+	int32_t						mNumThreadsPrev;
+
 	// Mesh scale
 	ci::Vec3f					mScale;
 
@@ -101,6 +105,7 @@ private:
 	bool						mTextureEnabled;
 
 	// Params and utilities
+	float						mBuildTime;
 	float						mFrameRate;
 	bool						mFullScreen;
 	ci::params::InterfaceGl		mParams;
@@ -111,6 +116,7 @@ private:
 #include "cinder/ImageIo.h"
 #include "cinder/Rand.h"
 #include "cinder/Surface.h"
+#include "cinder/Timer.h"
 #include "cinder/Utilities.h"
 #include "MeshHelper.h"
 #include "Resources.h"
@@ -122,6 +128,9 @@ using namespace std;
 // Creates TriMeshes
 void TriMeshSampleApp::createMeshes()
 {
+	// Time primitive generation for the params GUI
+	Timer timer( true );
+
 	// Use the MeshHelper to generate primitives
 	mCircle		= MeshHelper::createCircleTriMesh( mNumSegments );
 	mCone		= MeshHelper::createConeTriMesh( mNumSegments );
@@ -129,7 +138,8 @@ void TriMeshSampleApp::createMeshes()
 	mCylinder	= MeshHelper::createCylinderTriMesh( mNumSegments );
 	mRing		= MeshHelper::createRingTriMesh( mNumSegments );
 	mSphere		= MeshHelper::createSphereTriMesh( mNumSegments );
-	mPlane		= MeshHelper::createPlaneTriMesh(mNumSegments, mNumSegments);
+	mPlane		= MeshHelper::createPlaneTriMesh( mNumSegments, mNumSegments, mNumThreads );
+	mBuildTime	= (float)( timer.getSeconds() * 1000.0 );
 	
 	/////////////////////////////////////////////////////////////////////////////
 	// Custom mesh
@@ -187,8 +197,8 @@ void TriMeshSampleApp::createMeshes()
 		}
 	}
 
-	// Use the MeshHelper to create a TriMesh from our vectors
-	mCustom = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
+	// Use the MeshHelper to hand our vectors over to a TriMesh without copying them
+	mCustom = MeshHelper::adoptTriMesh( indices, positions, normals, texCoords );
 }
 
 void TriMeshSampleApp::draw()
@@ -310,12 +320,15 @@ void TriMeshSampleApp::setup()
 	mTexture = gl::Texture( loadImage( loadResource( RES_TEXTURE ) ) );
 
 	// Define properties
+	mBuildTime			= 0.0f;
 	mFrameRate			= 0.0f;
 	mFullScreen			= false;
 	mLightEnabled		= true;
 	mMeshIndex			= 0;
 	mNumSegments		= 48;
 	mNumSegmentsPrev	= mNumSegments;
+	mNumThreads			= 0;
+	mNumThreadsPrev		= mNumThreads;
 	mScale				= Vec3f::one();
 	mTextureEnabled		= true;
 	mWireframe			= false;
@@ -350,12 +363,14 @@ void TriMeshSampleApp::setup()
 	// Set up the params GUI
 	mParams = params::InterfaceGl( "Params", Vec2i( 200, 320 ) );
 	mParams.addParam( "Frame rate",		&mFrameRate,									"", true									);
+	mParams.addParam( "Build time (ms)",	&mBuildTime,									"", true									);
 	mParams.addSeparator();
 	mParams.addParam( "Enable light",	&mLightEnabled,									"key=l"										);
 	mParams.addParam( "Enable texture",	&mTextureEnabled,								"key=t"										);
 	mParams.addParam( "Mesh type",		mMeshTitles, &mMeshIndex,						"keyDecr=m keyIncr=M"						);
 	mParams.addParam( "Scale",			&mScale																						);
 	mParams.addParam( "Segments",		&mNumSegments,									"keyDecr=s keyIncr=S min=1 max=1024 step=1"	);
+	mParams.addParam( "Threads",		&mNumThreads,									"min=0 max=64 step=1"						);
 	mParams.addParam( "Wireframe",		&mWireframe,									"key=w"										);
 	mParams.addSeparator();
 	mParams.addParam( "Full screen",	&mFullScreen,									"key=f"										);
@@ -384,10 +399,11 @@ void TriMeshSampleApp::update()
 		setFullScreen( mFullScreen );
 	}
 
-	// Reset the meshes if the segment count changes
-	if ( mNumSegmentsPrev != mNumSegments ) {
+	// Reset the meshes if the segment or thread count changes
+	if ( mNumSegmentsPrev != mNumSegments || mNumThreadsPrev != mNumThreads ) {
 		createMeshes();
-		mNumSegmentsPrev = mNumSegments;
+		mNumSegmentsPrev	= mNumSegments;
+		mNumThreadsPrev		= mNumThreads;
 	}
 
 	// Update light on every frame
@@ -185,8 +185,8 @@ void TriMeshSampleApp::createMeshes()
 		}
 	}
 
-	// Use the MeshHelper to create a TriMesh from our vectors
-	mCustom = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
+	// Use the MeshHelper to hand our vectors over to a TriMesh without copying them
+	mCustom = MeshHelper::adoptTriMesh( indices, positions, normals, texCoords );
 }
 
 void TriMeshSampleApp::draw()
@@ -122,14 +122,25 @@ using namespace std;
 // Creates VBO meshes
 void VboMeshSampleApp::createMeshes()
 {
-	// Use the MeshHelper to generate primitives
-	mCircle		= MeshHelper::createCircleVboMesh( mNumSegments );
-	mCone		= MeshHelper::createConeVboMesh( mNumSegments );
-	mCube		= MeshHelper::createCubeVboMesh();
-	mCylinder	= MeshHelper::createCylinderVboMesh( mNumSegments );
-	mRing		= MeshHelper::createRingVboMesh( mNumSegments );
-	mSphere		= MeshHelper::createSphereVboMesh( mNumSegments );
-	mSquare		= MeshHelper::createSquareVboMesh();
+	// Use the MeshHelper to generate primitives on all cores
+	vector<MeshHelper::Primitive> primitives;
+	primitives.push_back( MeshHelper::Primitive::circle( mNumSegments ) );
+	primitives.push_back( MeshHelper::Primitive::cone( mNumSegments ) );
+	primitives.push_back( MeshHelper::Primitive::cube() );
+	primitives.push_back( MeshHelper::Primitive::cylinder( mNumSegments ) );
+	primitives.push_back( MeshHelper::Primitive::ring( mNumSegments ) );
+	primitives.push_back( MeshHelper::Primitive::sphere( mNumSegments ) );
+	primitives.push_back( MeshHelper::Primitive::plane() );
+	vector<MeshHelper::TriMeshRef> meshes = MeshHelper::createTriMeshes( primitives );
+
+	// Upload them to the GPU on this thread
+	mCircle		= MeshHelper::createVboMesh( *meshes[ 0 ] );
+	mCone		= MeshHelper::createVboMesh( *meshes[ 1 ] );
+	mCube		= MeshHelper::createVboMesh( *meshes[ 2 ] );
+	mCylinder	= MeshHelper::createVboMesh( *meshes[ 3 ] );
+	mRing		= MeshHelper::createVboMesh( *meshes[ 4 ] );
+	mSphere		= MeshHelper::createVboMesh( *meshes[ 5 ] );
+	mSquare		= MeshHelper::createVboMesh( *meshes[ 6 ] );
 	
 	/////////////////////////////////////////////////////////////////////////////
 	// Custom mesh
@@ -162,30 +173,26 @@ void VboMeshSampleApp::createMeshes()
 			Vec3f position( (float)x - halfWidth, value, (float)y - halfHeight );
 			positions.push_back( position * scale + offset );
 
-			// Add a default normal for now (we'll calculate this down below)
-			normals.push_back( Vec3f::zero() );
-
-			// Add indices to form quad from two triangles
+			// Add indices to form quad from two triangles, wound 
+			// counter-clockwise from above so their normals face up
 			int32_t xn = x + 1 >= mNumSegments ? 0 : 1;
 			int32_t yn = y + 1 >= mNumSegments ? 0 : 1;
 			indices.push_back( x + mNumSegments * y );
-			indices.push_back( ( x + xn ) + mNumSegments * y);
 			indices.push_back( ( x + xn ) + mNumSegments * ( y + yn ) );
+			indices.push_back( ( x + xn ) + mNumSegments * y);
 			indices.push_back( x + mNumSegments * ( y + yn ) );
 			indices.push_back( ( x + xn ) + mNumSegments * ( y + yn ) );
 			indices.push_back( x + mNumSegments * y );
 		}
 	}
 
-	// Iterate through again to set normals
-	for ( int32_t y = 0; y < mNumSegments - 1; y++ ) {
-		for ( int32_t x = 0; x < mNumSegments - 1; x++ ) {
-			Vec3f vert0 = positions[ indices[ ( x + mNumSegments * y ) * 6 ] ];
-			Vec3f vert1 = positions[ indices[ ( ( x + 1 ) + mNumSegments * y ) * 6 ] ];
-			Vec3f vert2 = positions[ indices[ ( ( x + 1 ) + mNumSegments * ( y + 1 ) ) * 6 ] ];
-			normals[ x + mNumSegments * y ] = Vec3f( ( vert1 - vert0 ).cross( vert1 - vert2 ).normalized() );
-		}
-	}
+	// Use the MeshHelper to smooth normals from the triangles around each vertex
+	MeshHelper::calcNormals( indices, positions, normals );
+
+	// Reorder the triangles so the GPU transforms fewer vertices, then
+	// store the vertices in the order the triangles use them
+	MeshHelper::optimizeVertexCache( indices, positions.size() );
+	MeshHelper::optimizeVertexFetch( indices, positions, normals, texCoords );
 
 	// Use the MeshHelper to create a VBO from our vectors
 	mCustom = MeshHelper::createVboMesh( indices, positions, normals, texCoords );
@@ -34,6 +34,42 @@
 */
 
 #include "MeshHelper.h"
+
+#include "cinder/Thread.h"
+
+#if ! defined( MESHHELPER_NO_SIMD )
+	#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+		#define MESHHELPER_SSE
+		#include <emmintrin.h>
+		// AVX kernels are compiled alongside SSE ones and chosen at runtime
+		#if defined( _MSC_FULL_VER ) && _MSC_FULL_VER >= 160040219
+			#define MESHHELPER_AVX
+			#define MESHHELPER_AVX_TARGET
+			#include <immintrin.h>
+			#include <intrin.h>
+		#elif defined( __clang__ ) || ( defined( __GNUC__ ) && ( __GNUC__ > 4 || ( __GNUC__ == 4 && __GNUC_MINOR__ >= 9 ) ) )
+			#define MESHHELPER_AVX
+			#define MESHHELPER_AVX_TARGET __attribute__(( target( "avx" ) ))
+			#include <immintrin.h>
+			#include <cpuid.h>
+		#endif
+	#elif defined( __ARM_NEON__ ) || defined( __ARM_NEON )
+		#define MESHHELPER_NEON
+		#include <arm_neon.h>
+	#endif
+#endif
+
+#if defined( __linux__ )
+	#include <sys/mman.h>
+#endif
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <exception>
+#include <list>
+#include <queue>
+#include <unordered_map>
 	
 using namespace ci;
 using namespace std;
@@ -41,656 +77,5264 @@ using namespace std;
 TriMesh MeshHelper::createTriMesh( vector<uint32_t> &indices, const vector<Vec3f> &positions, 
 	const vector<Vec3f> &normals, const vector<Vec2f> &texCoords )
 {
-	TriMesh mesh;
-	if ( indices.size() > 0 ) {
-		mesh.appendIndices( &indices[ 0 ], indices.size() );
-	}
-	if ( normals.size() > 0 ) {
-		for ( vector<Vec3f>::const_iterator iter = normals.begin(); iter != normals.end(); ++iter ) {
-			mesh.appendNormal( *iter );
+	TriMesh mesh;
+	mesh.getIndices().assign( indices.begin(), indices.end() );
+	mesh.getNormals().assign( normals.begin(), normals.end() );
+	mesh.getVertices().assign( positions.begin(), positions.end() );
+	mesh.getTexCoords().assign( texCoords.begin(), texCoords.end() );
+	return mesh;
+}
+
+TriMesh MeshHelper::adoptTriMesh( vector<uint32_t> &indices, vector<Vec3f> &positions, 
+	vector<Vec3f> &normals, vector<Vec2f> &texCoords )
+{
+	TriMesh mesh;
+	mesh.getIndices().swap( indices );
+	mesh.getNormals().swap( normals );
+	mesh.getVertices().swap( positions );
+	mesh.getTexCoords().swap( texCoords );
+	return mesh;
+}
+
+
+namespace
+{
+
+// Destination array of T with elements stride bytes apart, which lets the 
+// generators write planar and interleaved layouts alike. Null data skips it.
+template<typename T>
+struct Strided
+{
+	uint8_t		*mData;
+	size_t		mStride;
+	//! Set for arrays too big to stay in cache, whose SIMD stores then bypass it.
+	bool		mStream;
+
+	Strided( void *data = 0, size_t stride = sizeof( T ), bool stream = false )
+		: mData( reinterpret_cast<uint8_t*>( data ) ), mStride( stride ), mStream( stream )
+	{
+	}
+
+	inline bool			isNull() const { return mData == 0; }
+	// True when elements are tightly packed, so runs of them can be stored with SIMD
+	inline bool			isPacked() const { return mStride == sizeof( T ); }
+	inline T			&operator[]( size_t i ) const { return *reinterpret_cast<T*>( mData + i * mStride ); }
+	inline Strided<T>	operator+( size_t i ) const { return Strided<T>( mData != 0 ? mData + i * mStride : 0, mStride, mStream ); }
+};
+
+// Destination arrays for the generators. Attributes and indices with null data are skipped.
+struct Output
+{
+	uint32_t		*mIndices;
+	//! 16-bit indices, used instead when mIndices is null.
+	uint16_t		*mIndices16;
+	Strided<Vec3f>	mNormals;
+	Strided<Vec3f>	mPositions;
+	Strided<Vec2f>	mTexCoords;
+	//! Unit tangents along increasing u, with the handedness of the bitangent in w.
+	Strided<Vec4f>	mTangents;
+	MeshHelper::Topology	mTopology;
+	//! Set when 32-bit indices should bypass the cache, like a streamed Strided.
+	bool			mStreamIndices;
+
+	Output()
+		: mIndices( 0 ), mIndices16( 0 ), mTopology( MeshHelper::TOPOLOGY_TRIANGLES ), mStreamIndices( false )
+	{
+	}
+
+	inline bool isStrip() const { return mTopology != MeshHelper::TOPOLOGY_TRIANGLES; }
+
+	inline void setIndex( size_t i, uint32_t index ) const
+	{
+		if ( mIndices != 0 ) {
+			mIndices[ i ] = index;
+		} else if ( mIndices16 != 0 ) {
+			mIndices16[ i ] = (uint16_t)index;
+		}
+	}
+
+	// Attribute arrays starting at vertex i
+	inline Strided<Vec3f> normals( size_t i ) const { return mNormals + i; }
+	inline Strided<Vec3f> positions( size_t i ) const { return mPositions + i; }
+	inline Strided<Vec2f> texCoords( size_t i ) const { return mTexCoords + i; }
+	inline Strided<Vec4f> tangents( size_t i ) const { return mTangents + i; }
+
+	inline void setVertex( size_t i, const Vec3f &position, const Vec3f &normal, const Vec2f &texCoord ) const
+	{
+		if ( !mNormals.isNull() ) {
+			mNormals[ i ] = normal;
+		}
+		if ( !mPositions.isNull() ) {
+			mPositions[ i ] = position;
+		}
+		if ( !mTexCoords.isNull() ) {
+			mTexCoords[ i ] = texCoord;
+		}
+	}
+
+	inline void setTangent( size_t i, const Vec4f &tangent ) const
+	{
+		if ( !mTangents.isNull() ) {
+			mTangents[ i ] = tangent;
+		}
+	}
+};
+
+// Writes consecutive indices to an Output. With strip topologies, strips 
+// are joined into one sequence by a restart index, or by repeating the 
+// last index of one strip and the first of the next. Stitched strips are 
+// padded to start on an even index, which keeps their winding.
+struct IndexWriter
+{
+	const Output	*mOut;
+	size_t			mIndex;
+	uint32_t		mLast;
+
+	IndexWriter( const Output &out, size_t index = 0, uint32_t last = 0 )
+		: mOut( &out ), mIndex( index ), mLast( last )
+	{
+	}
+
+	inline void add( uint32_t index )
+	{
+		mOut->setIndex( mIndex++, index );
+		mLast = index;
+	}
+
+	// Joins the strip about to start with first to the previous one
+	inline void beginStrip( uint32_t first )
+	{
+		if ( mIndex == 0 ) {
+			return;
+		}
+		if ( mOut->mTopology == MeshHelper::TOPOLOGY_STRIP_RESTART ) {
+			mOut->setIndex( mIndex++, 0xffffffff );
+		} else {
+			bool odd = mIndex % 2 != 0;
+			mOut->setIndex( mIndex++, mLast );
+			mOut->setIndex( mIndex++, first );
+			if ( odd ) {
+				mOut->setIndex( mIndex++, first );
+			}
+		}
+	}
+
+	// Adds the indices a strip of length takes to numIndices, joins included
+	static void countStrip( size_t length, MeshHelper::Topology topology, size_t *numIndices )
+	{
+		if ( length == 0 ) {
+			return;
+		}
+		if ( *numIndices > 0 ) {
+			if ( topology == MeshHelper::TOPOLOGY_STRIP_RESTART ) {
+				*numIndices += 1;
+			} else {
+				*numIndices += *numIndices % 2 != 0 ? 3 : 2;
+			}
+		}
+		*numIndices += length;
+	}
+};
+
+// Writes the band between two rows of count vertices as the strip a0, b0, 
+// a1, b1, ... Each quad gets the winding of ( a0, b0, a1 ) and ( a1, b0, b1 ).
+void writeBandStrip( uint32_t a, uint32_t b, uint32_t count, IndexWriter *w )
+{
+	if ( count == 0 ) {
+		return;
+	}
+	w->beginStrip( a );
+	for ( uint32_t t = 0; t < count; t++ ) {
+		w->add( a + t );
+		w->add( b + t );
+	}
+}
+
+// Writes a convex polygon of count vertices as a strip zigzagging across it, 
+// wound like the fan ( center, t, t + 1 ), or the other way when reverse is set
+void writePolygonStrip( uint32_t first, uint32_t count, bool reverse, IndexWriter *w )
+{
+	if ( count == 0 ) {
+		return;
+	}
+	w->beginStrip( first );
+	w->add( first );
+	uint32_t front	= 1;
+	uint32_t back	= count - 1;
+	for ( bool fromFront = !reverse; front <= back; fromFront = !fromFront ) {
+		w->add( first + ( fromFront ? front++ : back-- ) );
+	}
+}
+
+// Resolves a requested thread count, where zero means one per core
+uint32_t getNumThreads( uint32_t numThreads )
+{
+	if ( numThreads == 0 ) {
+		numThreads = thread::hardware_concurrency();
+	}
+	return numThreads > 0 ? numThreads : 1;
+}
+
+// Stores that bypass the cache are weakly ordered, so they are fenced 
+// before another thread is told the data they wrote is ready
+inline void fenceStreams()
+{
+#if defined( MESHHELPER_SSE )
+	_mm_sfence();
+#endif
+}
+
+// A range that the calling thread and pool workers take chunks of
+struct ParallelTask
+{
+	virtual ~ParallelTask() {}
+	virtual void	run( size_t begin, size_t end ) = 0;
+
+	size_t			mCount;
+	size_t			mGrain;
+	size_t			mNext;
+	uint32_t		mSlots;
+	uint32_t		mActive;
+	exception_ptr	mError;
+};
+
+template<typename Fn>
+struct ParallelFnTask : public ParallelTask
+{
+	Fn				*mFn;
+
+	void run( size_t begin, size_t end )
+	{
+		( *mFn )( begin, end );
+	}
+};
+
+/* Worker threads shared by every parallelFor(), started on first use with one 
+   fewer than the number of cores, since the calling thread works too. Workers 
+   help with any posted task that has slots left. A worker that calls 
+   parallelFor() itself posts a new task and works on it like any other 
+   caller, so nested calls can't deadlock. The pool is never destroyed, so 
+   workers are never joined; see getThreadPool(). */
+class ThreadPool
+{
+public:
+	ThreadPool()
+		: mStarted( false )
+	{
+	}
+
+	// Runs task on the calling thread and up to numThreads - 1 workers, then 
+	// rethrows the first exception thrown by any chunk
+	void run( ParallelTask &task, uint32_t numThreads )
+	{
+		unique_lock<mutex> lock( mMutex );
+		start();
+		task.mNext		= 0;
+		task.mSlots		= std::min<uint32_t>( numThreads - 1, (uint32_t)mThreads.size() );
+		task.mActive	= 1;
+		if ( task.mSlots > 0 ) {
+			mTasks.push_back( &task );
+			mWork.notify_all();
+		}
+		runChunks( task, lock );
+		task.mActive--;
+
+		// Once the task is off the list no more workers can join it, and 
+		// those still running chunks must finish before it goes out of scope
+		mTasks.erase( std::remove( mTasks.begin(), mTasks.end(), &task ), mTasks.end() );
+		while ( task.mActive > 0 ) {
+			mDone.wait( lock );
+		}
+		lock.unlock();
+		if ( task.mError ) {
+			rethrow_exception( task.mError );
+		}
+	}
+private:
+	struct Worker
+	{
+		ThreadPool	*mPool;
+
+		void operator()()
+		{
+			mPool->work();
+		}
+	};
+
+	// Starts the workers, keeping as many as could be created
+	void start()
+	{
+		if ( mStarted ) {
+			return;
+		}
+		mStarted = true;
+		uint32_t numThreads = getNumThreads( 0 );
+		Worker worker;
+		worker.mPool = this;
+		try {
+			mThreads.reserve( numThreads - 1 );
+			for ( uint32_t i = 1; i < numThreads; ++i ) {
+				mThreads.push_back( new thread( worker ) );
+			}
+		} catch ( ... ) {
+		}
+	}
+
+	// Takes chunks of task until it runs out or a chunk throws. Called 
+	// and returns with the lock held.
+	void runChunks( ParallelTask &task, unique_lock<mutex> &lock )
+	{
+		while ( !task.mError && task.mNext < task.mCount ) {
+			size_t begin	= task.mNext;
+			size_t end		= std::min( begin + task.mGrain, task.mCount );
+			task.mNext		= end;
+			lock.unlock();
+			try {
+				task.run( begin, end );
+				fenceStreams();
+			} catch ( ... ) {
+				lock.lock();
+				if ( !task.mError ) {
+					task.mError = current_exception();
+				}
+				continue;
+			}
+			lock.lock();
+		}
+	}
+
+	void work()
+	{
+		unique_lock<mutex> lock( mMutex );
+		for ( ;; ) {
+			ParallelTask *task = 0;
+			for ( vector<ParallelTask *>::iterator iter = mTasks.begin(); iter != mTasks.end(); ++iter ) {
+				if ( ( *iter )->mSlots > 0 && !( *iter )->mError && ( *iter )->mNext < ( *iter )->mCount ) {
+					task = *iter;
+					break;
+				}
+			}
+			if ( task == 0 ) {
+				mWork.wait( lock );
+				continue;
+			}
+			task->mSlots--;
+			task->mActive++;
+			runChunks( *task, lock );
+			if ( --task->mActive == 0 ) {
+				mDone.notify_all();
+			}
+		}
+	}
+
+	bool					mStarted;
+	mutex					mMutex;
+	condition_variable		mWork;
+	condition_variable		mDone;
+	vector<ParallelTask *>	mTasks;
+	vector<thread *>		mThreads;
+};
+
+// The pool is created on first use and deliberately leaked. Joining its 
+// workers from a static destructor would deadlock under the loader lock when 
+// built into a Windows DLL, and parallelFor() would stop working for other 
+// static destructors. Idle workers just end with the process.
+ThreadPool &getThreadPool()
+{
+	static ThreadPool *pool = new ThreadPool();
+	return *pool;
+}
+
+/* Calls fn( begin, end ) over [ 0, count ) in chunks of grain, on up to 
+   numThreads threads including the calling one. Chunks must write to 
+   disjoint data. If any chunk throws, no more chunks are started and the 
+   first exception is rethrown here once all running chunks have finished. */
+template<typename Fn>
+void parallelFor( size_t count, size_t grain, uint32_t numThreads, Fn &fn )
+{
+	grain		= std::max<size_t>( grain, 1 );
+	numThreads	= (uint32_t)std::min<size_t>( getNumThreads( numThreads ), ( count + grain - 1 ) / grain );
+	if ( numThreads <= 1 ) {
+		if ( count > 0 ) {
+			fn( 0, count );
+		}
+		return;
+	}
+
+	ParallelFnTask<Fn> task;
+	task.mFn	= &fn;
+	task.mCount	= count;
+	task.mGrain	= grain;
+	getThreadPool().run( task, numThreads );
+}
+
+// Cosine and sine of 2 * pi * t / segments for t in [ 0, segments ]
+typedef std::shared_ptr<const vector<Vec2f> > CircleTableRef;
+
+struct CircleTableEntry
+{
+	CircleTableRef				mTable;
+	list<uint32_t>::iterator	mUse;
+};
+
+// Tables are kept for the most recently used segment counts within a byte 
+// budget, so sweeping through counts doesn't leave a table behind for each. 
+// Tables larger than the budget are built for each use. Evicted tables live 
+// on while generators still hold them.
+const size_t						kCircleTableBudget	= 1024 * 1024;
+mutex								sCircleTableMutex;
+map<uint32_t, CircleTableEntry>		sCircleTables;
+list<uint32_t>						sCircleTableUse;
+size_t								sCircleTableSize	= 0;
+
+inline size_t calcCircleTableBytes( uint32_t segments )
+{
+	return ( (size_t)segments + 1 ) * sizeof( Vec2f );
+}
+
+// Returns the unit circle table for segments, from the cache when it was used recently
+CircleTableRef getCircleTable( uint32_t segments )
+{
+	{
+		lock_guard<mutex> lock( sCircleTableMutex );
+		map<uint32_t, CircleTableEntry>::iterator iter = sCircleTables.find( segments );
+		if ( iter != sCircleTables.end() ) {
+			sCircleTableUse.splice( sCircleTableUse.begin(), sCircleTableUse, iter->second.mUse );
+			return iter->second.mTable;
+		}
+	}
+
+	// Evaluate each angle directly in double precision so there is no 
+	// accumulated drift, and close the circle exactly at the seam. The 
+	// table is built outside the lock so other threads are not held up.
+	vector<Vec2f> *table = new vector<Vec2f>( segments + 1 );
+	double delta = ( M_PI * 2.0 ) / (double)segments;
+	for ( uint32_t t = 0; t < segments; t++ ) {
+		double theta = delta * (double)t;
+		( *table )[ t ] = Vec2f( (float)math<double>::cos( theta ), (float)math<double>::sin( theta ) );
+	}
+	( *table )[ segments ] = ( *table )[ 0 ];
+	CircleTableRef ref( table );
+
+	size_t bytes = calcCircleTableBytes( segments );
+	if ( bytes > kCircleTableBudget ) {
+		return ref;
+	}
+	lock_guard<mutex> lock( sCircleTableMutex );
+	map<uint32_t, CircleTableEntry>::iterator iter = sCircleTables.find( segments );
+	if ( iter != sCircleTables.end() ) {
+		return iter->second.mTable;
+	}
+	CircleTableEntry &entry	= sCircleTables[ segments ];
+	entry.mTable			= ref;
+	entry.mUse				= sCircleTableUse.insert( sCircleTableUse.begin(), segments );
+	sCircleTableSize		+= bytes;
+	while ( sCircleTableSize > kCircleTableBudget ) {
+		sCircleTableSize -= calcCircleTableBytes( sCircleTableUse.back() );
+		sCircleTables.erase( sCircleTableUse.back() );
+		sCircleTableUse.pop_back();
+	}
+	return ref;
+}
+
+void clearCircleTables()
+{
+	lock_guard<mutex> lock( sCircleTableMutex );
+	sCircleTables.clear();
+	sCircleTableUse.clear();
+	sCircleTableSize = 0;
+}
+
+// SIMD kernels for the hot vertex fill loops. Each kernel has a scalar 
+// path, used for tails, for interleaved destinations, when SIMD is 
+// unavailable and when it is disabled at runtime. Destinations may be 
+// null to skip an attribute. Filling big meshes is bound by memory 
+// bandwidth rather than arithmetic, so on x86 the kernels store whole 
+// aligned 16 or 32 byte blocks, which bypass the cache for streamed 
+// outputs. That saves reading each cache line in before overwriting it.
+
+bool sSimdEnabled = true;
+
+#if defined( MESHHELPER_SSE )
+
+// Instruction sets, in the order the kernels prefer them
+enum SimdLevel { SIMD_NONE, SIMD_SSE2, SIMD_AVX };
+
+// Asks the CPU which of SSE2 and AVX it has, and the OS whether it saves 
+// the AVX registers on a context switch
+SimdLevel detectSimd()
+{
+	uint32_t ecx = 0, edx = 0;
+#if defined( _MSC_VER )
+	int info[ 4 ];
+	__cpuid( info, 1 );
+	ecx = (uint32_t)info[ 2 ];
+	edx = (uint32_t)info[ 3 ];
+#else
+	uint32_t eax = 0, ebx = 0;
+	if ( __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) == 0 ) {
+		return SIMD_NONE;
+	}
+#endif
+	if ( ( edx & ( 1 << 26 ) ) == 0 ) {
+		return SIMD_NONE;
+	}
+#if defined( MESHHELPER_AVX )
+	// AVX, and XGETBV to see that the OS enabled the XMM and YMM state
+	if ( ( ecx & ( 1 << 28 ) ) != 0 && ( ecx & ( 1 << 27 ) ) != 0 ) {
+	#if defined( _MSC_VER )
+		uint64_t xcr0 = _xgetbv( 0 );
+	#else
+		uint32_t xcr0Low = 0, xcr0High = 0;
+		__asm__ __volatile__ ( ".byte 0x0f, 0x01, 0xd0" : "=a"( xcr0Low ), "=d"( xcr0High ) : "c"( 0 ) );
+		uint64_t xcr0 = xcr0Low;
+	#endif
+		if ( ( xcr0 & 6 ) == 6 ) {
+			return SIMD_AVX;
+		}
+	}
+#endif
+	return SIMD_SSE2;
+}
+
+// Scalar until this is initialized, should a static constructor elsewhere 
+// generate a mesh first
+const SimdLevel sSimdLevel = detectSimd();
+
+#endif
+
+inline bool useSimd()
+{
+#if defined( MESHHELPER_SSE )
+	return sSimdEnabled && sSimdLevel >= SIMD_SSE2;
+#elif defined( MESHHELPER_NEON )
+	return sSimdEnabled;
+#else
+	return false;
+#endif
+}
+
+inline bool useAvx()
+{
+#if defined( MESHHELPER_AVX )
+	return sSimdEnabled && sSimdLevel == SIMD_AVX;
+#else
+	return false;
+#endif
+}
+
+inline Vec3f ringPoint( const Vec2f &cs, const Vec3f &axisCos, const Vec3f &axisSin, const Vec3f &offset )
+{
+	return Vec3f( 
+		( cs.x * axisCos.x + cs.y * axisSin.x ) + offset.x, 
+		( cs.x * axisCos.y + cs.y * axisSin.y ) + offset.y, 
+		( cs.x * axisCos.z + cs.y * axisSin.z ) + offset.z );
+}
+
+inline Vec4f ringTangent( const Vec2f &cs, const Vec3f &axisCos, const Vec3f &axisSin, float w )
+{
+	return Vec4f( cs.x * axisCos.x + cs.y * axisSin.x, cs.x * axisCos.y + cs.y * axisSin.y, 
+		cs.x * axisCos.z + cs.y * axisSin.z, w );
+}
+
+// Writes the quad a, a + 1, b, b + 1 as two triangles, as fillQuads() does
+inline void setQuad( uint32_t *dst, uint32_t a, uint32_t b, bool flip )
+{
+	dst[ 0 ] = a;
+	dst[ 1 ] = flip ? b : a + 1;
+	dst[ 2 ] = flip ? a + 1 : b;
+	dst[ 3 ] = flip ? a + 1 : b;
+	dst[ 4 ] = flip ? b : a + 1;
+	dst[ 5 ] = b + 1;
+}
+
+#if defined( MESHHELPER_SSE )
+
+// Number of elements to store one at a time before dst is aligned to 
+// align bytes, 16 or 32, or count when it never will be
+template<typename T>
+inline size_t alignHead( const Strided<T> &dst, size_t count, size_t align )
+{
+	for ( size_t i = 0; i < 8 && i < count; ++i ) {
+		if ( ( reinterpret_cast<size_t>( &dst[ i ] ) & ( align - 1 ) ) == 0 ) {
+			return i;
+		}
+	}
+	return count;
+}
+
+inline void storeAligned( float *dst, __m128 v, bool stream )
+{
+	if ( stream ) {
+		_mm_stream_ps( dst, v );
+	} else {
+		_mm_store_ps( dst, v );
+	}
+}
+
+inline void storeAligned( uint32_t *dst, __m128i v, bool stream )
+{
+	if ( stream ) {
+		_mm_stream_si128( reinterpret_cast<__m128i*>( dst ), v );
+	} else {
+		_mm_store_si128( reinterpret_cast<__m128i*>( dst ), v );
+	}
+}
+
+// Transposes four vectors from xxxx, yyyy, zzzz form into twelve packed floats
+inline void storeVec3x4( float *dst, __m128 x, __m128 y, __m128 z )
+{
+	__m128 xy01 = _mm_unpacklo_ps( x, y );
+	__m128 xy23 = _mm_unpackhi_ps( x, y );
+	__m128 yz01 = _mm_unpacklo_ps( y, z );
+	__m128 yz23 = _mm_unpackhi_ps( y, z );
+	__m128 zx01 = _mm_unpacklo_ps( z, x );
+	__m128 zx23 = _mm_unpackhi_ps( z, x );
+	_mm_storeu_ps( dst,		_mm_shuffle_ps( xy01, zx01, _MM_SHUFFLE( 3, 0, 1, 0 ) ) );
+	_mm_storeu_ps( dst + 4, _mm_shuffle_ps( yz01, xy23, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	_mm_storeu_ps( dst + 8, _mm_shuffle_ps( zx23, yz23, _MM_SHUFFLE( 3, 2, 3, 0 ) ) );
+}
+
+// storeVec3x4() to a 16 byte aligned dst
+inline void storeVec3x4Aligned( float *dst, __m128 x, __m128 y, __m128 z, bool stream )
+{
+	__m128 xy01 = _mm_unpacklo_ps( x, y );
+	__m128 xy23 = _mm_unpackhi_ps( x, y );
+	__m128 yz01 = _mm_unpacklo_ps( y, z );
+	__m128 yz23 = _mm_unpackhi_ps( y, z );
+	__m128 zx01 = _mm_unpacklo_ps( z, x );
+	__m128 zx23 = _mm_unpackhi_ps( z, x );
+	storeAligned( dst,		_mm_shuffle_ps( xy01, zx01, _MM_SHUFFLE( 3, 0, 1, 0 ) ), stream );
+	storeAligned( dst + 4,	_mm_shuffle_ps( yz01, xy23, _MM_SHUFFLE( 1, 0, 3, 2 ) ), stream );
+	storeAligned( dst + 8,	_mm_shuffle_ps( zx23, yz23, _MM_SHUFFLE( 3, 2, 3, 0 ) ), stream );
+}
+
+// Index ramp i, i + 1, i + 2, i + 3 divided by denom
+inline __m128 rampDiv( size_t i, float denom )
+{
+	__m128 index = _mm_add_ps( _mm_set1_ps( (float)i ), _mm_set_ps( 3.0f, 2.0f, 1.0f, 0.0f ) );
+	return _mm_div_ps( index, _mm_set1_ps( denom ) );
+}
+
+#endif
+
+#if defined( MESHHELPER_AVX )
+
+// The AVX kernels below each fill dst from i in blocks of eight, from a 32 
+// byte aligned start, and return where they stopped. They are only called 
+// when useAvx() is set, and the SSE and scalar loops finish the tail.
+
+MESHHELPER_AVX_TARGET inline void storeAligned( float *dst, __m256 v, bool stream )
+{
+	if ( stream ) {
+		_mm256_stream_ps( dst, v );
+	} else {
+		_mm256_store_ps( dst, v );
+	}
+}
+
+// storeVec3x4Aligned() for eight vectors, to a 32 byte aligned dst. Each 
+// 128-bit half transposes four of them, then the halves are interleaved.
+MESHHELPER_AVX_TARGET inline void storeVec3x8Aligned( float *dst, __m256 x, __m256 y, __m256 z, bool stream )
+{
+	__m256 xy01 = _mm256_unpacklo_ps( x, y );
+	__m256 xy23 = _mm256_unpackhi_ps( x, y );
+	__m256 yz01 = _mm256_unpacklo_ps( y, z );
+	__m256 yz23 = _mm256_unpackhi_ps( y, z );
+	__m256 zx01 = _mm256_unpacklo_ps( z, x );
+	__m256 zx23 = _mm256_unpackhi_ps( z, x );
+	__m256 a	= _mm256_shuffle_ps( xy01, zx01, _MM_SHUFFLE( 3, 0, 1, 0 ) );
+	__m256 b	= _mm256_shuffle_ps( yz01, xy23, _MM_SHUFFLE( 1, 0, 3, 2 ) );
+	__m256 c	= _mm256_shuffle_ps( zx23, yz23, _MM_SHUFFLE( 3, 2, 3, 0 ) );
+	storeAligned( dst,		_mm256_permute2f128_ps( a, b, 0x20 ), stream );
+	storeAligned( dst + 8,	_mm256_permute2f128_ps( c, a, 0x30 ), stream );
+	storeAligned( dst + 16, _mm256_permute2f128_ps( b, c, 0x31 ), stream );
+}
+
+// Index ramp i to i + 7 divided by denom
+MESHHELPER_AVX_TARGET inline __m256 rampDiv8( size_t i, float denom )
+{
+	__m256 index = _mm256_add_ps( _mm256_set1_ps( (float)i ), 
+		_mm256_set_ps( 7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f ) );
+	return _mm256_div_ps( index, _mm256_set1_ps( denom ) );
+}
+
+// Loads the cosines and sines of eight table entries from i
+MESHHELPER_AVX_TARGET inline void loadCircle8( const Vec2f *table, size_t i, __m256 &c, __m256 &s )
+{
+	__m256 a	= _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( &table[ i ].x ) ), 
+		_mm_loadu_ps( &table[ i + 4 ].x ), 1 );
+	__m256 b	= _mm256_insertf128_ps( _mm256_castps128_ps256( _mm_loadu_ps( &table[ i + 2 ].x ) ), 
+		_mm_loadu_ps( &table[ i + 6 ].x ), 1 );
+	c			= _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+	s			= _mm256_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+}
+
+MESHHELPER_AVX_TARGET size_t fillRingAvx( const Strided<Vec3f> &dst, const Vec2f *table, size_t i, size_t count, 
+	const Vec3f &axisCos, const Vec3f &axisSin, const Vec3f &offset )
+{
+	for ( ; i + 8 <= count; i += 8 ) {
+		__m256 c, s;
+		loadCircle8( table, i, c, s );
+		__m256 x = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( c, _mm256_set1_ps( axisCos.x ) ), 
+			_mm256_mul_ps( s, _mm256_set1_ps( axisSin.x ) ) ), _mm256_set1_ps( offset.x ) );
+		__m256 y = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( c, _mm256_set1_ps( axisCos.y ) ), 
+			_mm256_mul_ps( s, _mm256_set1_ps( axisSin.y ) ) ), _mm256_set1_ps( offset.y ) );
+		__m256 z = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( c, _mm256_set1_ps( axisCos.z ) ), 
+			_mm256_mul_ps( s, _mm256_set1_ps( axisSin.z ) ) ), _mm256_set1_ps( offset.z ) );
+		storeVec3x8Aligned( &dst[ i ].x, x, y, z, dst.mStream );
+	}
+	return i;
+}
+
+MESHHELPER_AVX_TARGET size_t fillRingAvx( const Strided<Vec2f> &dst, const Vec2f *table, size_t i, size_t count, 
+	const Vec2f &scale, const Vec2f &offset )
+{
+	__m256 s = _mm256_setr_ps( scale.x, scale.y, scale.x, scale.y, scale.x, scale.y, scale.x, scale.y );
+	__m256 o = _mm256_setr_ps( offset.x, offset.y, offset.x, offset.y, offset.x, offset.y, offset.x, offset.y );
+	for ( ; i + 4 <= count; i += 4 ) {
+		storeAligned( &dst[ i ].x, _mm256_add_ps( _mm256_mul_ps( _mm256_loadu_ps( &table[ i ].x ), s ), o ), dst.mStream );
+	}
+	return i;
+}
+
+MESHHELPER_AVX_TARGET size_t fillRingAvx( const Strided<Vec4f> &dst, const Vec2f *table, size_t i, size_t count, 
+	const Vec3f &axisCos, const Vec3f &axisSin, float w )
+{
+	__m256 h = _mm256_set1_ps( w );
+	for ( ; i + 8 <= count; i += 8 ) {
+		__m256 c, s;
+		loadCircle8( table, i, c, s );
+		__m256 x	= _mm256_add_ps( _mm256_mul_ps( c, _mm256_set1_ps( axisCos.x ) ), 
+			_mm256_mul_ps( s, _mm256_set1_ps( axisSin.x ) ) );
+		__m256 y	= _mm256_add_ps( _mm256_mul_ps( c, _mm256_set1_ps( axisCos.y ) ), 
+			_mm256_mul_ps( s, _mm256_set1_ps( axisSin.y ) ) );
+		__m256 z	= _mm256_add_ps( _mm256_mul_ps( c, _mm256_set1_ps( axisCos.z ) ), 
+			_mm256_mul_ps( s, _mm256_set1_ps( axisSin.z ) ) );
+		__m256 xy01 = _mm256_unpacklo_ps( x, y );
+		__m256 zw01 = _mm256_unpacklo_ps( z, h );
+		__m256 xy23 = _mm256_unpackhi_ps( x, y );
+		__m256 zw23 = _mm256_unpackhi_ps( z, h );
+		__m256 v0	= _mm256_shuffle_ps( xy01, zw01, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m256 v1	= _mm256_shuffle_ps( xy01, zw01, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		__m256 v2	= _mm256_shuffle_ps( xy23, zw23, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+		__m256 v3	= _mm256_shuffle_ps( xy23, zw23, _MM_SHUFFLE( 3, 2, 3, 2 ) );
+		storeAligned( &dst[ i ].x,		_mm256_permute2f128_ps( v0, v1, 0x20 ), dst.mStream );
+		storeAligned( &dst[ i + 2 ].x,	_mm256_permute2f128_ps( v2, v3, 0x20 ), dst.mStream );
+		storeAligned( &dst[ i + 4 ].x,	_mm256_permute2f128_ps( v0, v1, 0x31 ), dst.mStream );
+		storeAligned( &dst[ i + 6 ].x,	_mm256_permute2f128_ps( v2, v3, 0x31 ), dst.mStream );
+	}
+	return i;
+}
+
+MESHHELPER_AVX_TARGET size_t fillLineAvx( const Strided<Vec3f> &dst, size_t i, size_t count, float denom, 
+	const Vec3f &origin, const Vec3f &extent )
+{
+	for ( ; i + 8 <= count; i += 8 ) {
+		__m256 t = rampDiv8( i, denom );
+		storeVec3x8Aligned( &dst[ i ].x, 
+			_mm256_add_ps( _mm256_set1_ps( origin.x ), _mm256_mul_ps( _mm256_set1_ps( extent.x ), t ) ), 
+			_mm256_add_ps( _mm256_set1_ps( origin.y ), _mm256_mul_ps( _mm256_set1_ps( extent.y ), t ) ), 
+			_mm256_add_ps( _mm256_set1_ps( origin.z ), _mm256_mul_ps( _mm256_set1_ps( extent.z ), t ) ), dst.mStream );
+	}
+	return i;
+}
+
+MESHHELPER_AVX_TARGET size_t fillLineAvx( const Strided<Vec2f> &dst, size_t i, size_t count, float denom, 
+	const Vec2f &origin, const Vec2f &extent )
+{
+	for ( ; i + 8 <= count; i += 8 ) {
+		__m256 t	= rampDiv8( i, denom );
+		__m256 x	= _mm256_add_ps( _mm256_set1_ps( origin.x ), _mm256_mul_ps( _mm256_set1_ps( extent.x ), t ) );
+		__m256 y	= _mm256_add_ps( _mm256_set1_ps( origin.y ), _mm256_mul_ps( _mm256_set1_ps( extent.y ), t ) );
+		__m256 lo	= _mm256_unpacklo_ps( x, y );
+		__m256 hi	= _mm256_unpackhi_ps( x, y );
+		storeAligned( &dst[ i ].x,		_mm256_permute2f128_ps( lo, hi, 0x20 ), dst.mStream );
+		storeAligned( &dst[ i + 4 ].x,	_mm256_permute2f128_ps( lo, hi, 0x31 ), dst.mStream );
+	}
+	return i;
+}
+
+// Streams value to dst, eight at a time
+MESHHELPER_AVX_TARGET size_t fillConstantAvx( const Strided<Vec3f> &dst, size_t i, size_t count, const Vec3f &value )
+{
+	__m256 a = _mm256_setr_ps( value.x, value.y, value.z, value.x, value.y, value.z, value.x, value.y );
+	__m256 b = _mm256_setr_ps( value.z, value.x, value.y, value.z, value.x, value.y, value.z, value.x );
+	__m256 c = _mm256_setr_ps( value.y, value.z, value.x, value.y, value.z, value.x, value.y, value.z );
+	for ( ; i + 8 <= count; i += 8 ) {
+		_mm256_stream_ps( &dst[ i ].x,		a );
+		_mm256_stream_ps( &dst[ i ].x + 8,	b );
+		_mm256_stream_ps( &dst[ i ].x + 16, c );
+	}
+	return i;
+}
+
+// Streams value to dst, two at a time
+MESHHELPER_AVX_TARGET size_t fillConstantAvx( const Strided<Vec4f> &dst, size_t i, size_t count, const Vec4f &value )
+{
+	__m256 v = _mm256_setr_ps( value.x, value.y, value.z, value.w, value.x, value.y, value.z, value.w );
+	for ( ; i + 2 <= count; i += 2 ) {
+		_mm256_stream_ps( &dst[ i ].x, v );
+	}
+	return i;
+}
+
+#endif
+
+// dst[ i ] = axisCos * cos + axisSin * sin + offset, from a unit circle table
+void fillRing( const Strided<Vec3f> &dst, const Vec2f *table, size_t count, const Vec3f &axisCos, 
+	const Vec3f &axisSin, const Vec3f &offset )
+{
+	if ( dst.isNull() ) {
+		return;
+	}
+	size_t i = 0;
+	if ( useSimd() && dst.isPacked() ) {
+#if defined( MESHHELPER_SSE )
+		for ( size_t head = alignHead( dst, count, useAvx() ? 32 : 16 ); i < head; ++i ) {
+			dst[ i ] = ringPoint( table[ i ], axisCos, axisSin, offset );
+		}
+#if defined( MESHHELPER_AVX )
+		if ( useAvx() ) {
+			i = fillRingAvx( dst, table, i, count, axisCos, axisSin, offset );
+		}
+#endif
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 a	= _mm_loadu_ps( &table[ i ].x );
+			__m128 b	= _mm_loadu_ps( &table[ i + 2 ].x );
+			__m128 c	= _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+			__m128 s	= _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+			__m128 x	= _mm_add_ps( _mm_add_ps( _mm_mul_ps( c, _mm_set1_ps( axisCos.x ) ), 
+				_mm_mul_ps( s, _mm_set1_ps( axisSin.x ) ) ), _mm_set1_ps( offset.x ) );
+			__m128 y	= _mm_add_ps( _mm_add_ps( _mm_mul_ps( c, _mm_set1_ps( axisCos.y ) ), 
+				_mm_mul_ps( s, _mm_set1_ps( axisSin.y ) ) ), _mm_set1_ps( offset.y ) );
+			__m128 z	= _mm_add_ps( _mm_add_ps( _mm_mul_ps( c, _mm_set1_ps( axisCos.z ) ), 
+				_mm_mul_ps( s, _mm_set1_ps( axisSin.z ) ) ), _mm_set1_ps( offset.z ) );
+			storeVec3x4Aligned( &dst[ i ].x, x, y, z, dst.mStream );
+		}
+#elif defined( MESHHELPER_NEON )
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4x2_t cs = vld2q_f32( &table[ i ].x );
+			float32x4x3_t v;
+			v.val[ 0 ] = vaddq_f32( vaddq_f32( vmulq_n_f32( cs.val[ 0 ], axisCos.x ), 
+				vmulq_n_f32( cs.val[ 1 ], axisSin.x ) ), vdupq_n_f32( offset.x ) );
+			v.val[ 1 ] = vaddq_f32( vaddq_f32( vmulq_n_f32( cs.val[ 0 ], axisCos.y ), 
+				vmulq_n_f32( cs.val[ 1 ], axisSin.y ) ), vdupq_n_f32( offset.y ) );
+			v.val[ 2 ] = vaddq_f32( vaddq_f32( vmulq_n_f32( cs.val[ 0 ], axisCos.z ), 
+				vmulq_n_f32( cs.val[ 1 ], axisSin.z ) ), vdupq_n_f32( offset.z ) );
+			vst3q_f32( &dst[ i ].x, v );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		dst[ i ] = ringPoint( table[ i ], axisCos, axisSin, offset );
+	}
+}
+
+// dst[ i ] = ( cos, sin ) * scale + offset, from a unit circle table
+void fillRing( const Strided<Vec2f> &dst, const Vec2f *table, size_t count, const Vec2f &scale, const Vec2f &offset )
+{
+	if ( dst.isNull() ) {
+		return;
+	}
+	size_t i = 0;
+	if ( useSimd() && dst.isPacked() ) {
+#if defined( MESHHELPER_SSE )
+		for ( size_t head = alignHead( dst, count, useAvx() ? 32 : 16 ); i < head; ++i ) {
+			dst[ i ] = Vec2f( table[ i ].x * scale.x + offset.x, table[ i ].y * scale.y + offset.y );
+		}
+#if defined( MESHHELPER_AVX )
+		if ( useAvx() ) {
+			i = fillRingAvx( dst, table, i, count, scale, offset );
+		}
+#endif
+		__m128 s = _mm_set_ps( scale.y, scale.x, scale.y, scale.x );
+		__m128 o = _mm_set_ps( offset.y, offset.x, offset.y, offset.x );
+		for ( ; i + 2 <= count; i += 2 ) {
+			storeAligned( &dst[ i ].x, _mm_add_ps( _mm_mul_ps( _mm_loadu_ps( &table[ i ].x ), s ), o ), dst.mStream );
+		}
+#elif defined( MESHHELPER_NEON )
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4x2_t cs = vld2q_f32( &table[ i ].x );
+			cs.val[ 0 ] = vaddq_f32( vmulq_n_f32( cs.val[ 0 ], scale.x ), vdupq_n_f32( offset.x ) );
+			cs.val[ 1 ] = vaddq_f32( vmulq_n_f32( cs.val[ 1 ], scale.y ), vdupq_n_f32( offset.y ) );
+			vst2q_f32( &dst[ i ].x, cs );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		dst[ i ] = Vec2f( table[ i ].x * scale.x + offset.x, table[ i ].y * scale.y + offset.y );
+	}
+}
+
+// dst[ i ] = ( axisCos * cos + axisSin * sin, w ), from a unit circle table
+void fillRing( const Strided<Vec4f> &dst, const Vec2f *table, size_t count, const Vec3f &axisCos, 
+	const Vec3f &axisSin, float w )
+{
+	if ( dst.isNull() ) {
+		return;
+	}
+	size_t i = 0;
+	if ( useSimd() && dst.isPacked() ) {
+#if defined( MESHHELPER_SSE )
+		for ( size_t head = alignHead( dst, count, useAvx() ? 32 : 16 ); i < head; ++i ) {
+			dst[ i ] = ringTangent( table[ i ], axisCos, axisSin, w );
+		}
+#if defined( MESHHELPER_AVX )
+		if ( useAvx() ) {
+			i = fillRingAvx( dst, table, i, count, axisCos, axisSin, w );
+		}
+#endif
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 a	= _mm_loadu_ps( &table[ i ].x );
+			__m128 b	= _mm_loadu_ps( &table[ i + 2 ].x );
+			__m128 c	= _mm_shuffle_ps( a, b, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+			__m128 s	= _mm_shuffle_ps( a, b, _MM_SHUFFLE( 3, 1, 3, 1 ) );
+			__m128 x	= _mm_add_ps( _mm_mul_ps( c, _mm_set1_ps( axisCos.x ) ), 
+				_mm_mul_ps( s, _mm_set1_ps( axisSin.x ) ) );
+			__m128 y	= _mm_add_ps( _mm_mul_ps( c, _mm_set1_ps( axisCos.y ) ), 
+				_mm_mul_ps( s, _mm_set1_ps( axisSin.y ) ) );
+			__m128 z	= _mm_add_ps( _mm_mul_ps( c, _mm_set1_ps( axisCos.z ) ), 
+				_mm_mul_ps( s, _mm_set1_ps( axisSin.z ) ) );
+			__m128 h	= _mm_set1_ps( w );
+			_MM_TRANSPOSE4_PS( x, y, z, h );
+			storeAligned( &dst[ i ].x,		x, dst.mStream );
+			storeAligned( &dst[ i + 1 ].x,	y, dst.mStream );
+			storeAligned( &dst[ i + 2 ].x,	z, dst.mStream );
+			storeAligned( &dst[ i + 3 ].x,	h, dst.mStream );
+		}
+#elif defined( MESHHELPER_NEON )
+		float32x4x4_t v;
+		v.val[ 3 ] = vdupq_n_f32( w );
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4x2_t cs = vld2q_f32( &table[ i ].x );
+			v.val[ 0 ] = vaddq_f32( vmulq_n_f32( cs.val[ 0 ], axisCos.x ), vmulq_n_f32( cs.val[ 1 ], axisSin.x ) );
+			v.val[ 1 ] = vaddq_f32( vmulq_n_f32( cs.val[ 0 ], axisCos.y ), vmulq_n_f32( cs.val[ 1 ], axisSin.y ) );
+			v.val[ 2 ] = vaddq_f32( vmulq_n_f32( cs.val[ 0 ], axisCos.z ), vmulq_n_f32( cs.val[ 1 ], axisSin.z ) );
+			vst4q_f32( &dst[ i ].x, v );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		dst[ i ] = ringTangent( table[ i ], axisCos, axisSin, w );
+	}
+}
+
+// dst[ i ] = origin + extent * ( i / denom ), exact at both ends of the line
+void fillLine( const Strided<Vec3f> &dst, size_t count, float denom, const Vec3f &origin, const Vec3f &extent )
+{
+	if ( dst.isNull() ) {
+		return;
+	}
+	size_t i = 0;
+	if ( useSimd() && dst.isPacked() ) {
+#if defined( MESHHELPER_SSE )
+		for ( size_t head = alignHead( dst, count, useAvx() ? 32 : 16 ); i < head; ++i ) {
+			float t = (float)i / denom;
+			dst[ i ] = Vec3f( origin.x + extent.x * t, origin.y + extent.y * t, origin.z + extent.z * t );
+		}
+#if defined( MESHHELPER_AVX )
+		if ( useAvx() ) {
+			i = fillLineAvx( dst, i, count, denom, origin, extent );
+		}
+#endif
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 t = rampDiv( i, denom );
+			storeVec3x4Aligned( &dst[ i ].x, 
+				_mm_add_ps( _mm_set1_ps( origin.x ), _mm_mul_ps( _mm_set1_ps( extent.x ), t ) ), 
+				_mm_add_ps( _mm_set1_ps( origin.y ), _mm_mul_ps( _mm_set1_ps( extent.y ), t ) ), 
+				_mm_add_ps( _mm_set1_ps( origin.z ), _mm_mul_ps( _mm_set1_ps( extent.z ), t ) ), dst.mStream );
+		}
+#elif defined( MESHHELPER_NEON )
+		// NEON has no exact vector divide on ARMv7, so only the stores are vectorized
+		for ( ; i + 4 <= count; i += 4 ) {
+			float t[ 4 ] = { (float)i / denom, (float)( i + 1 ) / denom, (float)( i + 2 ) / denom, 
+				(float)( i + 3 ) / denom };
+			float32x4_t tv = vld1q_f32( t );
+			float32x4x3_t v;
+			v.val[ 0 ] = vaddq_f32( vdupq_n_f32( origin.x ), vmulq_n_f32( tv, extent.x ) );
+			v.val[ 1 ] = vaddq_f32( vdupq_n_f32( origin.y ), vmulq_n_f32( tv, extent.y ) );
+			v.val[ 2 ] = vaddq_f32( vdupq_n_f32( origin.z ), vmulq_n_f32( tv, extent.z ) );
+			vst3q_f32( &dst[ i ].x, v );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		float t = (float)i / denom;
+		dst[ i ] = Vec3f( origin.x + extent.x * t, origin.y + extent.y * t, origin.z + extent.z * t );
+	}
+}
+
+// dst[ i ] = origin + extent * ( i / denom ), exact at both ends of the line
+void fillLine( const Strided<Vec2f> &dst, size_t count, float denom, const Vec2f &origin, const Vec2f &extent )
+{
+	if ( dst.isNull() ) {
+		return;
+	}
+	size_t i = 0;
+	if ( useSimd() && dst.isPacked() ) {
+#if defined( MESHHELPER_SSE )
+		for ( size_t head = alignHead( dst, count, useAvx() ? 32 : 16 ); i < head; ++i ) {
+			float t = (float)i / denom;
+			dst[ i ] = Vec2f( origin.x + extent.x * t, origin.y + extent.y * t );
+		}
+#if defined( MESHHELPER_AVX )
+		if ( useAvx() ) {
+			i = fillLineAvx( dst, i, count, denom, origin, extent );
+		}
+#endif
+		for ( ; i + 4 <= count; i += 4 ) {
+			__m128 t = rampDiv( i, denom );
+			__m128 x = _mm_add_ps( _mm_set1_ps( origin.x ), _mm_mul_ps( _mm_set1_ps( extent.x ), t ) );
+			__m128 y = _mm_add_ps( _mm_set1_ps( origin.y ), _mm_mul_ps( _mm_set1_ps( extent.y ), t ) );
+			storeAligned( &dst[ i ].x,		_mm_unpacklo_ps( x, y ), dst.mStream );
+			storeAligned( &dst[ i + 2 ].x,	_mm_unpackhi_ps( x, y ), dst.mStream );
+		}
+#elif defined( MESHHELPER_NEON )
+		for ( ; i + 4 <= count; i += 4 ) {
+			float t[ 4 ] = { (float)i / denom, (float)( i + 1 ) / denom, (float)( i + 2 ) / denom, 
+				(float)( i + 3 ) / denom };
+			float32x4_t tv = vld1q_f32( t );
+			float32x4x2_t v;
+			v.val[ 0 ] = vaddq_f32( vdupq_n_f32( origin.x ), vmulq_n_f32( tv, extent.x ) );
+			v.val[ 1 ] = vaddq_f32( vdupq_n_f32( origin.y ), vmulq_n_f32( tv, extent.y ) );
+			vst2q_f32( &dst[ i ].x, v );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		float t = (float)i / denom;
+		dst[ i ] = Vec2f( origin.x + extent.x * t, origin.y + extent.y * t );
+	}
+}
+
+// dst[ i ] = value
+void fillConstant( const Strided<Vec3f> &dst, size_t count, const Vec3f &value )
+{
+	if ( dst.isNull() ) {
+		return;
+	}
+	size_t i = 0;
+	if ( useSimd() && dst.isPacked() ) {
+#if defined( MESHHELPER_SSE )
+		// Copying a constant is no faster with SSE unless the stores bypass the cache
+		if ( dst.mStream ) {
+			for ( size_t head = alignHead( dst, count, useAvx() ? 32 : 16 ); i < head; ++i ) {
+				dst[ i ] = value;
+			}
+#if defined( MESHHELPER_AVX )
+			if ( useAvx() ) {
+				i = fillConstantAvx( dst, i, count, value );
+			}
+#endif
+			__m128 a = _mm_set_ps( value.x, value.z, value.y, value.x );
+			__m128 b = _mm_set_ps( value.y, value.x, value.z, value.y );
+			__m128 c = _mm_set_ps( value.z, value.y, value.x, value.z );
+			for ( ; i + 4 <= count; i += 4 ) {
+				_mm_stream_ps( &dst[ i ].x,		a );
+				_mm_stream_ps( &dst[ i ].x + 4, b );
+				_mm_stream_ps( &dst[ i ].x + 8, c );
+			}
+		}
+#elif defined( MESHHELPER_NEON )
+		float32x4x3_t v;
+		v.val[ 0 ] = vdupq_n_f32( value.x );
+		v.val[ 1 ] = vdupq_n_f32( value.y );
+		v.val[ 2 ] = vdupq_n_f32( value.z );
+		for ( ; i + 4 <= count; i += 4 ) {
+			vst3q_f32( &dst[ i ].x, v );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		dst[ i ] = value;
+	}
+}
+
+// dst[ i ] = value
+void fillConstant( const Strided<Vec4f> &dst, size_t count, const Vec4f &value )
+{
+	if ( dst.isNull() ) {
+		return;
+	}
+	size_t i = 0;
+#if defined( MESHHELPER_SSE )
+	// Copying a constant is no faster with SSE unless the stores bypass the cache
+	if ( useSimd() && dst.isPacked() && dst.mStream ) {
+		for ( size_t head = alignHead( dst, count, useAvx() ? 32 : 16 ); i < head; ++i ) {
+			dst[ i ] = value;
+		}
+#if defined( MESHHELPER_AVX )
+		if ( useAvx() ) {
+			i = fillConstantAvx( dst, i, count, value );
+		}
+#endif
+		__m128 v = _mm_set_ps( value.w, value.z, value.y, value.x );
+		for ( ; i < count; ++i ) {
+			_mm_stream_ps( &dst[ i ].x, v );
+		}
+	}
+#endif
+	for ( ; i < count; ++i ) {
+		dst[ i ] = value;
+	}
+}
+
+// Writes count quads along a band of a grid to the 32-bit indices of out 
+// from i, each as the two triangles ( a, a + 1, b ) and ( b, a + 1, b + 1 ), 
+// or ( a, b, a + 1 ) and ( a + 1, b, b + 1 ) when flip is set, as a and b 
+// advance by one
+void fillQuads( const Output &out, size_t i, size_t count, uint32_t a, uint32_t b, bool flip )
+{
+	uint32_t *dst	= out.mIndices + i;
+	size_t q		= 0;
+#if defined( MESHHELPER_SSE )
+	if ( useSimd() ) {
+		// A quad is 24 bytes, so one quad realigns 8 byte aligned indices
+		size_t head = ( reinterpret_cast<size_t>( dst ) & 7 ) != 0 ? count : 
+			std::min<size_t>( ( reinterpret_cast<size_t>( dst ) & 15 ) != 0 ? 1 : 0, count );
+		for ( ; q < head; ++q ) {
+			setQuad( dst + q * 6, a + (uint32_t)q, b + (uint32_t)q, flip );
+		}
+
+		// Two quads are twelve indices, in three vectors that all advance by two
+		uint32_t ai		= a + (uint32_t)q;
+		uint32_t bi		= b + (uint32_t)q;
+		__m128i v0		= flip ? _mm_setr_epi32( ai, bi, ai + 1, ai + 1 ) : _mm_setr_epi32( ai, ai + 1, bi, bi );
+		__m128i v1		= flip ? _mm_setr_epi32( bi, bi + 1, ai + 1, bi + 1 ) : 
+			_mm_setr_epi32( ai + 1, bi + 1, ai + 1, ai + 2 );
+		__m128i v2		= flip ? _mm_setr_epi32( ai + 2, ai + 2, bi + 1, bi + 2 ) : 
+			_mm_setr_epi32( bi + 1, bi + 1, ai + 2, bi + 2 );
+		__m128i step	= _mm_set1_epi32( 2 );
+		for ( ; q + 2 <= count; q += 2 ) {
+			uint32_t *quad = dst + q * 6;
+			storeAligned( quad,		v0, out.mStreamIndices );
+			storeAligned( quad + 4, v1, out.mStreamIndices );
+			storeAligned( quad + 8, v2, out.mStreamIndices );
+			v0 = _mm_add_epi32( v0, step );
+			v1 = _mm_add_epi32( v1, step );
+			v2 = _mm_add_epi32( v2, step );
+		}
+	}
+#endif
+	for ( ; q < count; ++q ) {
+		setQuad( dst + q * 6, a + (uint32_t)q, b + (uint32_t)q, flip );
+	}
+}
+
+/* Writes the quads between each of rows [ rowBegin, rowEnd ) of a grid and 
+   the next. The grid is rows of columns vertices from vertex first, and its 
+   indices follow those already written by w. Each row's indices go to a place 
+   known up front, as one strip per row with strip topologies, so bands of rows 
+   can be written in parallel. Quads are wound like ( a0, a1, b0 ), where row b 
+   follows row a. */
+void writeGridRows( uint32_t first, uint32_t columns, uint32_t rows, uint32_t rowBegin, uint32_t rowEnd, 
+	const IndexWriter &w )
+{
+	if ( columns < 2 || rows < 2 ) {
+		return;
+	}
+	rowEnd = std::min( rowEnd, rows - 1 );
+
+	const Output &out = *w.mOut;
+	if ( out.isStrip() ) {
+		// Every strip has the same even length, so once the first is joined 
+		// on an even index, the joins between the rest are the same size
+		bool restart		= out.mTopology == MeshHelper::TOPOLOGY_STRIP_RESTART;
+		size_t length		= (size_t)columns * 2;
+		size_t join			= restart ? 1 : 2;
+		size_t firstJoin	= w.mIndex == 0 ? 0 : ( restart ? 1 : ( w.mIndex % 2 != 0 ? 3 : 2 ) );
+		for ( uint32_t y = rowBegin; y < rowEnd; y++ ) {
+			IndexWriter row = y == 0 ? w : 
+				IndexWriter( out, w.mIndex + firstJoin + y * ( length + join ) - join, first + y * columns - 1 );
+			writeBandStrip( first + ( y + 1 ) * columns, first + y * columns, columns, &row );
+		}
+		return;
+	}
+
+	size_t i = w.mIndex + (size_t)rowBegin * ( columns - 1 ) * 6;
+	for ( uint32_t y = rowBegin; y < rowEnd; y++ ) {
+		if ( out.mIndices != 0 ) {
+			fillQuads( out, i, columns - 1, first + y * columns, first + ( y + 1 ) * columns, false );
+			i += (size_t)( columns - 1 ) * 6;
+			continue;
+		}
+		for ( uint32_t x = 0; x < columns - 1; x++ ) {
+			uint32_t index0 = first + ( y * columns ) + x;
+			uint32_t index1 = index0 + 1;
+			uint32_t index2 = first + ( ( y + 1 ) * columns ) + x;
+			uint32_t index3 = index2 + 1;
+
+			out.setIndex( i++, index0 );
+			out.setIndex( i++, index1 );
+			out.setIndex( i++, index2 );
+
+			out.setIndex( i++, index2 );
+			out.setIndex( i++, index1 );
+			out.setIndex( i++, index3 );
+		}
+	}
+}
+
+// Advances w past the indices writeGridRows() writes for a whole grid, 
+// as if it had written them
+void skipGridRows( uint32_t first, uint32_t columns, uint32_t rows, IndexWriter *w )
+{
+	if ( columns < 2 || rows < 2 ) {
+		return;
+	}
+	if ( w->mOut->isStrip() ) {
+		for ( uint32_t y = 0; y + 1 < rows; y++ ) {
+			IndexWriter::countStrip( (size_t)columns * 2, w->mOut->mTopology, &w->mIndex );
+		}
+		w->mLast = first + ( rows - 1 ) * columns - 1;
+	} else {
+		w->mIndex += (size_t)( columns - 1 ) * ( rows - 1 ) * 6;
+	}
+}
+
+// Tangent t of a surface facing normal, with a w of 1.0 when bitangent b is on 
+// the side of normal.cross( t ), or -1.0 where the texture is mirrored
+inline Vec4f orientTangent( const Vec3f &normal, const Vec3f &t, const Vec3f &b )
+{
+	return Vec4f( t, normal.cross( t ).dot( b ) < 0.0f ? -1.0f : 1.0f );
+}
+
+// Directions the texture coordinates u and v increase in across a triangle with 
+// edges e1 and e2, whose texture coordinates change by t1 and t2 along them. Both 
+// are scaled by twice the area of the triangle in texture space, so they vanish 
+// rather than blow up where the texture is squashed to a line.
+inline void texCoordDirections( const Vec3f &e1, const Vec3f &e2, const Vec2f &t1, const Vec2f &t2, 
+	Vec3f *u, Vec3f *v )
+{
+	float det	= t1.x * t2.y - t2.x * t1.y;
+	float sign	= det > 0.0f ? 1.0f : ( det < 0.0f ? -1.0f : 0.0f );
+	*u			= ( e1 * t2.y - e2 * t1.y ) * sign;
+	*v			= ( e2 * t1.x - e1 * t2.x ) * sign;
+}
+
+// Unit tangent along direction u made perpendicular to normal, with the handedness 
+// of direction v. Where u is lost, as where the texture doesn't vary, the tangent 
+// is made from v, or any direction perpendicular to the normal.
+inline Vec4f finishTangent( const Vec3f &normal, const Vec3f &u, const Vec3f &v )
+{
+	Vec3f t = u - normal * normal.dot( u );
+	if ( t.lengthSquared() <= u.lengthSquared() * 1e-6f ) {
+		t = v.cross( normal );
+		if ( t.lengthSquared() <= v.lengthSquared() * 1e-6f ) {
+			t = normal.cross( math<float>::abs( normal.x ) < 0.9f ? Vec3f::xAxis() : Vec3f::yAxis() );
+		}
+	}
+	return orientTangent( normal, t.safeNormalized(), v );
+}
+
+// Adds the directions of the texture coordinates across triangle a, b, c 
+// to those of its corners, with u at dst[ i * 2 ] and v at dst[ i * 2 + 1 ]
+inline void addTexCoordDirections( uint32_t a, uint32_t b, uint32_t c, const Vec3f *positions, 
+	const Vec2f *texCoords, Vec3f *dst )
+{
+	Vec3f u;
+	Vec3f v;
+	texCoordDirections( positions[ b ] - positions[ a ], positions[ c ] - positions[ a ], 
+		texCoords[ b ] - texCoords[ a ], texCoords[ c ] - texCoords[ a ], &u, &v );
+	dst[ a * 2 ] += u;
+	dst[ a * 2 + 1 ] += v;
+	dst[ b * 2 ] += u;
+	dst[ b * 2 + 1 ] += v;
+	dst[ c * 2 ] += u;
+	dst[ c * 2 + 1 ] += v;
+}
+
+// Writes a disc of radius at height y around the Y axis as a fan of 
+// triangles around a center vertex, using planar texture coordinates
+void writeCap( uint32_t segments, float radius, float y, const Vec3f &normal, bool flip, 
+	uint32_t *v, IndexWriter *w, const Output &out )
+{
+	// Texture coordinates run along X, and along Z unless flipped
+	Vec4f tangent	= orientTangent( normal, Vec3f::xAxis(), Vec3f( 0.0f, 0.0f, flip ? -1.0f : 1.0f ) );
+	uint32_t center	= *v;
+	out.setVertex( center, Vec3f( 0.0f, y, 0.0f ), normal, Vec2f::one() * 0.5f );
+	out.setTangent( center, tangent );
+
+	CircleTableRef table = getCircleTable( segments );
+	fillRing( out.positions( center + 1 ), &( *table )[ 0 ], segments, Vec3f( radius, 0.0f, 0.0f ), 
+		Vec3f( 0.0f, 0.0f, radius ), Vec3f( 0.0f, y, 0.0f ) );
+	fillConstant( out.normals( center + 1 ), segments, normal );
+	fillRing( out.texCoords( center + 1 ), &( *table )[ 0 ], segments, Vec2f( 0.5f, flip ? -0.5f : 0.5f ), 
+		Vec2f::one() * 0.5f );
+	fillConstant( out.tangents( center + 1 ), segments, tangent );
+
+	if ( out.isStrip() ) {
+		// The strip zigzags across the rim, leaving the center unused
+		writePolygonStrip( center + 1, segments, false, w );
+	} else {
+		for ( uint32_t t = 0; t < segments; t++ ) {
+			uint32_t n = t + 1 >= segments ? 0 : t + 1;
+			w->add( center );
+			w->add( center + 1 + t );
+			w->add( center + 1 + n );
+		}
+	}
+	*v += segments + 1;
+}
+
+// Slanted normal for the side of a frustum with a height of 1.0
+inline Vec3f sideNormal( float cosT, float sinT, float topRadius, float baseRadius )
+{
+	return Vec3f( cosT, baseRadius - topRadius, sinT ).normalized();
+}
+
+// Writes the ring of a frustum side with a height of 1.0 at height y, 
+// with slanted normals and a texture seam vertex. Tangents follow the 
+// ring, which turns from X to Z, the opposite way to the surface seen 
+// from outside, so the texture is mirrored.
+void writeSideRing( uint32_t segments, const Vec2f *table, float radius, float y, float topRadius, 
+	float baseRadius, uint32_t v, const Output &out )
+{
+	// The slanted normal of ( cos, baseRadius - topRadius, sin ) has 
+	// the same length all the way around
+	float slope		= baseRadius - topRadius;
+	float scale		= 1.0f / math<float>::sqrt( 1.0f + slope * slope );
+	fillRing( out.positions( v ), table, segments + 1, Vec3f( radius, 0.0f, 0.0f ), Vec3f( 0.0f, 0.0f, radius ), 
+		Vec3f( 0.0f, y, 0.0f ) );
+	fillRing( out.normals( v ), table, segments + 1, Vec3f( scale, 0.0f, 0.0f ), Vec3f( 0.0f, 0.0f, scale ), 
+		Vec3f( 0.0f, slope * scale, 0.0f ) );
+	fillLine( out.texCoords( v ), segments + 1, (float)segments, Vec2f( 0.0f, y + 0.5f ), Vec2f( 1.0f, 0.0f ) );
+	fillRing( out.tangents( v ), table, segments + 1, Vec3f( 0.0f, 0.0f, 1.0f ), Vec3f( -1.0f, 0.0f, 0.0f ), -1.0f );
+}
+
+void generateCircle( uint32_t segments, const Output &out )
+{
+	Vec3f norm0( 0.0f, 0.0f, 1.0f );
+	Vec4f tan0 = orientTangent( norm0, Vec3f::xAxis(), Vec3f::yAxis() );
+	out.setVertex( 0, Vec3f::zero(), norm0, Vec2f::one() * 0.5f );
+	out.setTangent( 0, tan0 );
+
+	CircleTableRef table = getCircleTable( segments );
+	fillRing( out.positions( 1 ), &( *table )[ 0 ], segments, Vec3f( 1.0f, 0.0f, 0.0f ), Vec3f( 0.0f, 1.0f, 0.0f ), 
+		Vec3f::zero() );
+	fillConstant( out.normals( 1 ), segments, norm0 );
+	fillRing( out.texCoords( 1 ), &( *table )[ 0 ], segments, Vec2f::one() * 0.5f, Vec2f::one() * 0.5f );
+	fillConstant( out.tangents( 1 ), segments, tan0 );
+
+	if ( out.isStrip() ) {
+		IndexWriter w( out );
+		writePolygonStrip( 1, segments, true, &w );
+		return;
+	}
+
+	uint32_t i = 0;
+	for ( uint32_t t = 0; t < segments; ++t ) {
+		uint32_t n = t + 1 >= segments ? 0 : t + 1;
+		out.setIndex( i++, t + 1 );
+		out.setIndex( i++, 0 );
+		out.setIndex( i++, n + 1 );
+	}
+}
+
+// Writes the vertices of rows [ rowBegin, rowEnd ) of the side of a frustum with a 
+// height of 1.0 split into layers bands, and the quads between them and the next. 
+// Rows run from the top down, starting at row firstRow of the whole side so cones 
+// can leave out their top ring. The side's vertices start at first, and its indices 
+// follow those already written by w.
+void generateSideRows( uint32_t segments, uint32_t layers, uint32_t firstRow, float topRadius, float baseRadius, 
+	const Vec2f *table, uint32_t first, const IndexWriter &w, uint32_t rowBegin, uint32_t rowEnd )
+{
+	for ( uint32_t y = rowBegin; y < rowEnd; y++ ) {
+		float s = (float)( y + firstRow ) / (float)layers;
+		writeSideRing( segments, table, topRadius * ( 1.0f - s ) + baseRadius * s, 0.5f - s, topRadius, baseRadius, 
+			first + y * ( segments + 1 ), *w.mOut );
+	}
+	writeGridRows( first, segments + 1, layers + 1 - firstRow, rowBegin, rowEnd, w );
+}
+
+// Runs generateSideRows() over a band of rows for parallelFor()
+struct SideJob
+{
+	uint32_t		mSegments;
+	uint32_t		mLayers;
+	uint32_t		mFirstRow;
+	float			mTopRadius;
+	float			mBaseRadius;
+	CircleTableRef	mTable;
+	uint32_t		mFirst;
+	size_t			mIndex;
+	uint32_t		mLast;
+	Output			mOut;
+
+	void operator()( size_t begin, size_t end )
+	{
+		generateSideRows( mSegments, mLayers, mFirstRow, mTopRadius, mBaseRadius, &( *mTable )[ 0 ], mFirst, 
+			IndexWriter( mOut, mIndex, mLast ), (uint32_t)begin, (uint32_t)end );
+	}
+};
+
+// Writes a frustum side from vertex *v, with its indices following those 
+// already written by w, then moves both past it. The side is generated in 
+// bands of rows like a plane, and is identical for any thread count.
+void writeSide( uint32_t segments, uint32_t layers, uint32_t firstRow, float topRadius, float baseRadius, 
+	uint32_t numThreads, uint32_t *v, IndexWriter *w, const Output &out )
+{
+	static const size_t kMinVerticesPerBand = 16384;
+
+	SideJob job;
+	job.mSegments	= segments;
+	job.mLayers		= layers;
+	job.mFirstRow	= firstRow;
+	job.mTopRadius	= topRadius;
+	job.mBaseRadius	= baseRadius;
+	job.mTable		= getCircleTable( segments );
+	job.mFirst		= *v;
+	job.mIndex		= w->mIndex;
+	job.mLast		= w->mLast;
+	job.mOut		= out;
+
+	uint32_t rows	= layers + 1 - firstRow;
+	size_t grain	= std::max<size_t>( kMinVerticesPerBand / ( segments + 1 ), 1 );
+	numThreads		= getNumThreads( numThreads );
+	grain			= std::max<size_t>( grain, rows / ( numThreads * 4 ) );
+	parallelFor( rows, grain, numThreads, job );
+
+	skipGridRows( *v, segments + 1, rows, w );
+	*v += rows * ( segments + 1 );
+}
+
+void generateCone( uint32_t segments, bool closeBase, uint32_t layers, uint32_t numThreads, const Output &out )
+{
+	// The apex is split into one vertex per segment so each face gets its own 
+	// normal, facing the middle of the segment. Those angles are the odd entries 
+	// in the table for twice the segment count.
+	CircleTableRef halfTable = getCircleTable( segments * 2 );
+	Vec3f apex( 0.0f, 0.5f, 0.0f );
+	for ( uint32_t t = 0; t < segments; t++ ) {
+		const Vec2f &cs = ( *halfTable )[ t * 2 + 1 ];
+		out.setVertex( t, apex, sideNormal( cs.x, cs.y, 0.0f, 1.0f ), 
+			Vec2f( ( (float)t + 0.5f ) / (float)segments, 1.0f ) );
+		out.setTangent( t, Vec4f( -cs.y, 0.0f, cs.x, -1.0f ) );
+	}
+
+	// The triangles around the apex reach down to the first ring, 
+	// which starts the grid making up the rest of the side
+	uint32_t ring = segments;
+	IndexWriter w( out );
+	if ( out.isStrip() ) {
+		// The apex vertices share a position, so the triangles 
+		// between them in the strip have no area
+		writeBandStrip( ring, 0, segments, &w );
+		w.add( ring + segments );
+	} else {
+		for ( uint32_t t = 0; t < segments; t++ ) {
+			w.add( ring + t );
+			w.add( t );
+			w.add( ring + t + 1 );
+		}
+	}
+
+	uint32_t v = segments;
+	writeSide( segments, layers, 1, 0.0f, 1.0f, numThreads, &v, &w, out );
+
+	if ( closeBase ) {
+		writeCap( segments, 1.0f, -0.5f, Vec3f( 0.0f, -1.0f, 0.0f ), false, &v, &w, out );
+	}
+}
+
+/* Normal, first corner, and the steps along and between rows of each cube face, 
+   ordered so its grid is wound counterclockwise as seen from outside. Steps all 
+   go toward positive coordinates, so faces sharing an edge compute the vertices 
+   along it alike. Then the texture coordinates of the first corner and the steps. */
+const float kCubeFaces[ 6 ][ 4 ][ 3 ] = {
+	{ { 1.0f, 0.0f, 0.0f }, { 0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }, 
+	{ { 0.0f, 1.0f, 0.0f }, { -0.5f, 0.5f, -0.5f }, { 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f } }, 
+	{ { 0.0f, 0.0f, 1.0f }, { -0.5f, -0.5f, 0.5f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f } }, 
+	{ { -1.0f, 0.0f, 0.0f }, { -0.5f, -0.5f, -0.5f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 1.0f, 0.0f } }, 
+	{ { 0.0f, -1.0f, 0.0f }, { -0.5f, -0.5f, -0.5f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } }, 
+	{ { 0.0f, 0.0f, -1.0f }, { -0.5f, -0.5f, -0.5f }, { 0.0f, 1.0f, 0.0f }, { 1.0f, 0.0f, 0.0f } }
+};
+const float kCubeFaceTexCoords[ 6 ][ 3 ][ 2 ] = {
+	{ { 1.0f, 0.0f }, { -1.0f, 0.0f }, { 0.0f, 1.0f } }, 
+	{ { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 0.0f } }, 
+	{ { 1.0f, 0.0f }, { -1.0f, 0.0f }, { 0.0f, 1.0f } }, 
+	{ { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 0.0f } }, 
+	{ { 1.0f, 0.0f }, { -1.0f, 0.0f }, { 0.0f, 1.0f } }, 
+	{ { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 0.0f } }
+};
+
+inline Vec3f cubeFaceVector( uint32_t f, uint32_t i )
+{
+	return Vec3f( kCubeFaces[ f ][ i ][ 0 ], kCubeFaces[ f ][ i ][ 1 ], kCubeFaces[ f ][ i ][ 2 ] );
+}
+
+inline Vec2f cubeFaceTexCoord( uint32_t f, uint32_t i )
+{
+	return Vec2f( kCubeFaceTexCoords[ f ][ i ][ 0 ], kCubeFaceTexCoords[ f ][ i ][ 1 ] );
+}
+
+// Tangent of cube face f, from how its positions and texture coordinates step along and between rows
+inline Vec4f cubeFaceTangent( uint32_t f )
+{
+	Vec3f u;
+	Vec3f v;
+	texCoordDirections( cubeFaceVector( f, 2 ), cubeFaceVector( f, 3 ), cubeFaceTexCoord( f, 1 ), 
+		cubeFaceTexCoord( f, 2 ), &u, &v );
+	return orientTangent( cubeFaceVector( f, 0 ), u.normalized(), v );
+}
+
+/* Writes the vertices of rows [ rowBegin, rowEnd ) of a cube, counting the rows 
+   of all six faces in turn, and the quads between them and the next row of their 
+   face. The indices of face f start at faceIndices[ f ], after faceLasts[ f ]. */
+void generateCubeRows( uint32_t subdivisions, const size_t *faceIndices, const uint32_t *faceLasts, 
+	uint32_t rowBegin, uint32_t rowEnd, const Output &out )
+{
+	uint32_t columns = subdivisions + 1;
+	for ( uint32_t r = rowBegin; r < rowEnd; r++ ) {
+		uint32_t f	= r / columns;
+		uint32_t y	= r % columns;
+		uint32_t v	= r * columns;
+		float yRat	= (float)y / (float)subdivisions;
+		fillLine( out.positions( v ), columns, (float)subdivisions, cubeFaceVector( f, 1 ) + cubeFaceVector( f, 3 ) * yRat, 
+			cubeFaceVector( f, 2 ) );
+		fillConstant( out.normals( v ), columns, cubeFaceVector( f, 0 ) );
+		fillLine( out.texCoords( v ), columns, (float)subdivisions, 
+			cubeFaceTexCoord( f, 0 ) + cubeFaceTexCoord( f, 2 ) * yRat, cubeFaceTexCoord( f, 1 ) );
+		fillConstant( out.tangents( v ), columns, cubeFaceTangent( f ) );
+
+		writeGridRows( f * columns * columns, columns, columns, y, y + 1, IndexWriter( out, faceIndices[ f ], faceLasts[ f ] ) );
+	}
+}
+
+// Runs generateCubeRows() over a band of rows for parallelFor()
+struct CubeJob
+{
+	uint32_t	mSubdivisions;
+	size_t		mFaceIndices[ 6 ];
+	uint32_t	mFaceLasts[ 6 ];
+	Output		mOut;
+
+	void operator()( size_t begin, size_t end )
+	{
+		generateCubeRows( mSubdivisions, mFaceIndices, mFaceLasts, (uint32_t)begin, (uint32_t)end, mOut );
+	}
+};
+
+// Each face of a cube has its own grid of vertices, so its normals stay flat. 
+// The rows of all faces are generated in bands like a plane, and the result 
+// is identical for any thread count.
+void generateCube( uint32_t subdivisions, uint32_t numThreads, const Output &out )
+{
+	static const size_t kMinVerticesPerBand = 16384;
+
+	CubeJob job;
+	job.mSubdivisions	= subdivisions;
+	job.mOut			= out;
+
+	uint32_t columns = subdivisions + 1;
+	IndexWriter w( out );
+	for ( uint32_t f = 0; f < 6; ++f ) {
+		job.mFaceIndices[ f ]	= w.mIndex;
+		job.mFaceLasts[ f ]		= w.mLast;
+		skipGridRows( f * columns * columns, columns, columns, &w );
+	}
+
+	size_t grain	= std::max<size_t>( kMinVerticesPerBand / columns, 1 );
+	numThreads		= getNumThreads( numThreads );
+	grain			= std::max<size_t>( grain, columns * 6 / ( numThreads * 4 ) );
+	parallelFor( columns * 6, grain, numThreads, job );
+}
+
+void generateCylinder( uint32_t segments, float topRadius, float baseRadius, bool closeTop, bool closeBase, 
+	uint32_t layers, uint32_t numThreads, const Output &out )
+{
+	uint32_t v = 0;
+	IndexWriter w( out );
+	if ( closeTop ) {
+		writeCap( segments, topRadius, 0.5f, Vec3f( 0.0f, 1.0f, 0.0f ), true, &v, &w, out );
+	}
+
+	// The side is a grid of rings from the top down, each 
+	// repeating its first vertex at the texture seam
+	writeSide( segments, layers, 0, topRadius, baseRadius, numThreads, &v, &w, out );
+
+	if ( closeBase ) {
+		writeCap( segments, baseRadius, -0.5f, Vec3f( 0.0f, -1.0f, 0.0f ), false, &v, &w, out );
+	}
+}
+
+void generateRing( uint32_t segments, float secondRadius, const Output &out )
+{
+	Vec3f norm0( 0.0f, 0.0f, 1.0f );
+
+	// The outer ring is followed by the inner ring
+	CircleTableRef table = getCircleTable( segments );
+	for ( uint32_t r = 0; r < 2; ++r ) {
+		float radius = r == 0 ? 1.0f : secondRadius;
+		fillRing( out.positions( r * segments ), &( *table )[ 0 ], segments, Vec3f( radius, 0.0f, 0.0f ), 
+			Vec3f( 0.0f, radius, 0.0f ), Vec3f::zero() );
+		fillConstant( out.normals( r * segments ), segments, norm0 );
+		fillRing( out.texCoords( r * segments ), &( *table )[ 0 ], segments, Vec2f::one() * radius * 0.5f, 
+			Vec2f::one() * 0.5f );
+		fillConstant( out.tangents( r * segments ), segments, orientTangent( norm0, Vec3f::xAxis(), Vec3f::yAxis() ) );
+	}
+
+	if ( out.isStrip() ) {
+		// One strip around the ring, closed by repeating its first pair
+		IndexWriter w( out );
+		writeBandStrip( 0, segments, segments, &w );
+		w.add( 0 );
+		w.add( segments );
+		return;
+	}
+
+	uint32_t i = 0;
+	for ( uint32_t t = 0; t < segments; ++t ) {
+		uint32_t n = t + 1 >= segments ? 0 : t + 1;
+		uint32_t index0 = t;
+		uint32_t index1 = n;
+		uint32_t index2 = segments + t;
+		uint32_t index3 = segments + n;
+
+		out.setIndex( i++, index0 );
+		out.setIndex( i++, index2 );
+		out.setIndex( i++, index1 );
+		out.setIndex( i++, index1 );
+		out.setIndex( i++, index2 );
+		out.setIndex( i++, index3 );
+	}
+}
+
+// Vertex index on a sphere with single-vertex-per-segment pole rows 
+// and a duplicated seam column on every other ring
+inline uint32_t sphereIndex( uint32_t p, uint32_t t, uint32_t segments )
+{
+	return p == 0 ? t : segments + ( p - 1 ) * ( segments + 1 ) + t;
+}
+
+void generateSphere( uint32_t segments, uint32_t rings, const Output &out )
+{
+	// Latitude runs over half a circle, so its angles come from the 
+	// table for twice the ring count
+	CircleTableRef latitude		= getCircleTable( rings * 2 );
+	CircleTableRef longitude	= getCircleTable( segments );
+
+	// Poles get one vertex per segment, centered in it, so each pole 
+	// triangle has its own texture coordinate. Tangents run around the 
+	// Z axis, at the middle of the segment at the poles, like the apex 
+	// of a cone.
+	CircleTableRef halfLongitude;
+	if ( !out.mTangents.isNull() ) {
+		halfLongitude = getCircleTable( segments * 2 );
+	}
+	for ( uint32_t p = 0; p <= rings; p++ ) {
+		uint32_t v	= sphereIndex( p, 0, segments );
+		float cosP	= ( *latitude )[ p ].x;
+		float tv	= (float)p / (float)rings;
+		if ( p == 0 || p == rings ) {
+			Vec3f pole( 0.0f, 0.0f, -cosP );
+			fillConstant( out.positions( v ), segments, pole );
+			fillConstant( out.normals( v ), segments, pole );
+			fillLine( out.texCoords( v ), segments, (float)segments, Vec2f( 0.5f / (float)segments, tv ), 
+				Vec2f( 1.0f, 0.0f ) );
+			if ( halfLongitude ) {
+				for ( uint32_t t = 0; t < segments; t++ ) {
+					const Vec2f &cs = ( *halfLongitude )[ t * 2 + 1 ];
+					out.setTangent( v + t, Vec4f( -cs.y, cs.x, 0.0f, 1.0f ) );
+				}
+			}
+		} else {
+			float sinP = ( *latitude )[ p ].y;
+			fillRing( out.positions( v ), &( *longitude )[ 0 ], segments + 1, Vec3f( sinP, 0.0f, 0.0f ), 
+				Vec3f( 0.0f, sinP, 0.0f ), Vec3f( 0.0f, 0.0f, -cosP ) );
+			fillRing( out.normals( v ), &( *longitude )[ 0 ], segments + 1, Vec3f( sinP, 0.0f, 0.0f ), 
+				Vec3f( 0.0f, sinP, 0.0f ), Vec3f( 0.0f, 0.0f, -cosP ) );
+			fillLine( out.texCoords( v ), segments + 1, (float)segments, Vec2f( 0.0f, tv ), Vec2f( 1.0f, 0.0f ) );
+			fillRing( out.tangents( v ), &( *longitude )[ 0 ], segments + 1, Vec3f( 0.0f, 1.0f, 0.0f ), 
+				Vec3f( -1.0f, 0.0f, 0.0f ), 1.0f );
+		}
+	}
+
+	if ( out.isStrip() ) {
+		// The pole vertices share a position, so the triangles between 
+		// them in the pole strips have no area. The north strip runs 
+		// backwards to keep its winding.
+		IndexWriter w( out );
+		uint32_t row = sphereIndex( 1, 0, segments );
+		w.add( row + segments );
+		for ( uint32_t t = segments; t-- > 0; ) {
+			w.add( t );
+			w.add( row + t );
+		}
+		for ( uint32_t p = 1; p + 1 < rings; p++ ) {
+			writeBandStrip( sphereIndex( p, 0, segments ), sphereIndex( p + 1, 0, segments ), segments + 1, &w );
+		}
+		row = sphereIndex( rings - 1, 0, segments );
+		writeBandStrip( row, sphereIndex( rings, 0, segments ), segments, &w );
+		w.add( row + segments );
+		return;
+	}
+
+	// Only the quads between the poles need both of their triangles
+	uint32_t i = 0;
+	for ( uint32_t p = 0; p < rings; p++ ) {
+		if ( p > 0 && p + 1 < rings && out.mIndices != 0 ) {
+			fillQuads( out, i, segments, sphereIndex( p, 0, segments ), sphereIndex( p + 1, 0, segments ), true );
+			i += segments * 6;
+			continue;
+		}
+		for ( uint32_t t = 0; t < segments; t++ ) {
+			uint32_t index0 = sphereIndex( p, t, segments );
+			uint32_t index1 = sphereIndex( p + 1, t, segments );
+			if ( p > 0 ) {
+				out.setIndex( i++, index0 );
+				out.setIndex( i++, index1 );
+				out.setIndex( i++, index0 + 1 );
+			}
+			if ( p + 1 < rings ) {
+				out.setIndex( i++, p > 0 ? index0 + 1 : index0 );
+				out.setIndex( i++, index1 );
+				out.setIndex( i++, index1 + 1 );
+			}
+		}
+	}
+}
+
+// Vertex, edge and face counts of an icosphere net after subdivisions. Each 
+// subdivision adds a vertex per edge, splits each edge in two and adds three 
+// edges and three faces inside each face.
+void calcIcosphereSize( uint32_t subdivisions, size_t *numVertices, size_t *numEdges, size_t *numFaces )
+{
+	*numVertices	= 22;
+	*numEdges		= 41;
+	*numFaces		= 20;
+	for ( uint32_t s = 0; s < subdivisions; s++ ) {
+		*numVertices	+= *numEdges;
+		*numEdges		= *numEdges * 2 + *numFaces * 3;
+		*numFaces		*= 4;
+	}
+}
+
+// Index in a triangular grid of the vertex in row i and column j, where row i holds i + 1 vertices
+inline size_t triangleGridIndex( size_t i, size_t j )
+{
+	return i * ( i + 1 ) / 2 + j;
+}
+
+// Edge midpoints for icosphere subdivision, in an open addressing hash 
+// table keyed by the vertices at either end of the edge
+struct MidpointCache
+{
+	vector<uint64_t>	mKeys;
+	vector<uint32_t>	mVertices;
+	size_t				mMask;
+
+	// Sized to stay at most half full with numEdges edges
+	explicit MidpointCache( size_t numEdges )
+	{
+		size_t size = 1;
+		while ( size < numEdges * 2 ) {
+			size <<= 1;
+		}
+		mKeys.assign( size, ~(uint64_t)0 );
+		mVertices.resize( size );
+		mMask = size - 1;
+	}
+
+	// Returns the midpoint of a and b, which becomes vertex next if the edge is new
+	inline uint32_t find( uint32_t a, uint32_t b, uint32_t next )
+	{
+		uint64_t key	= a < b ? ( (uint64_t)a << 32 ) | b : ( (uint64_t)b << 32 ) | a;
+		size_t slot		= (size_t)( ( key * 0x9e3779b97f4a7c15ull ) >> 32 ) & mMask;
+		while ( mKeys[ slot ] != key ) {
+			if ( mKeys[ slot ] == ~(uint64_t)0 ) {
+				mKeys[ slot ]		= key;
+				mVertices[ slot ]	= next;
+				break;
+			}
+			slot = ( slot + 1 ) & mMask;
+		}
+		return mVertices[ slot ];
+	}
+};
+
+void generateIcosphere( uint32_t subdivisions, const Output &out )
+{
+	size_t numVertices	= 0;
+	size_t numEdges		= 0;
+	size_t numFaces		= 0;
+	calcIcosphereSize( subdivisions, &numVertices, &numEdges, &numFaces );
+
+	// The icosahedron is unfolded into a net of five columns of four faces, 
+	// which lays out the texture coordinates. Each column has a face at the 
+	// north pole, two around the middle and one at the south pole. Cutting 
+	// the net out repeats each pole once per column and the first vertex of 
+	// both rings. Rings are at a height of 1 / sqrt( 5 ), with the south 
+	// ring turned half a column, taking its angles from the table for ten.
+	vector<Vec3f> positions;
+	vector<Vec2f> texCoords;
+	positions.reserve( numVertices );
+	texCoords.reserve( numVertices );
+	CircleTableRef table	= getCircleTable( 10 );
+	float height			= 1.0f / math<float>::sqrt( 5.0f );
+	float radius			= 2.0f * height;
+	float width				= 5.5f;
+	for ( uint32_t k = 0; k < 5; k++ ) {
+		positions.push_back( Vec3f( 0.0f, 0.0f, -1.0f ) );
+		texCoords.push_back( Vec2f( ( (float)k + 0.5f ) / width, 0.0f ) );
+	}
+	for ( uint32_t r = 0; r < 2; r++ ) {
+		for ( uint32_t k = 0; k <= 5; k++ ) {
+			const Vec2f &cs = ( *table )[ ( k * 2 + r ) % 10 ];
+			positions.push_back( Vec3f( cs.x * radius, cs.y * radius, r == 0 ? -height : height ) );
+			texCoords.push_back( Vec2f( ( (float)k + (float)r * 0.5f ) / width, (float)( r + 1 ) / 3.0f ) );
+		}
+	}
+	for ( uint32_t k = 0; k < 5; k++ ) {
+		positions.push_back( Vec3f( 0.0f, 0.0f, 1.0f ) );
+		texCoords.push_back( Vec2f( (float)( k + 1 ) / width, 1.0f ) );
+	}
+
+	// Each face is a triangular grid with its first corner in row zero and 
+	// the other two at either end of the last row, starting with one row
+	vector<uint32_t> grid;
+	for ( uint32_t k = 0; k < 5; k++ ) {
+		uint32_t north	= k;
+		uint32_t upper	= 5 + k;
+		uint32_t lower	= 11 + k;
+		uint32_t south	= 17 + k;
+		uint32_t faces[ 4 ][ 3 ] = {
+			{ north, upper + 1, upper }, { upper, upper + 1, lower }, 
+			{ upper + 1, lower + 1, lower }, { lower, lower + 1, south }
+		};
+		grid.insert( grid.end(), &faces[ 0 ][ 0 ], &faces[ 0 ][ 0 ] + 12 );
+	}
+
+	// Subdividing doubles the rows of each grid. Vertices of the coarser 
+	// grid keep their index, and new ones are edge midpoints pushed out 
+	// onto the sphere, shared with the neighboring face by the cache.
+	size_t rows		= 1;
+	size_t edges	= 41;
+	for ( uint32_t s = 0; s < subdivisions; s++ ) {
+		size_t fineRows		= rows * 2;
+		size_t coarseSize	= triangleGridIndex( rows + 1, 0 );
+		size_t fineSize		= triangleGridIndex( fineRows + 1, 0 );
+		vector<uint32_t> fine( fineSize * 20 );
+		MidpointCache cache( edges );
+		for ( size_t f = 0; f < 20; f++ ) {
+			const uint32_t *coarse	= &grid[ f * coarseSize ];
+			uint32_t *dst			= &fine[ f * fineSize ];
+			for ( size_t i = 0; i <= fineRows; i++ ) {
+				for ( size_t j = 0; j <= i; j++ ) {
+					if ( i % 2 == 0 && j % 2 == 0 ) {
+						dst[ triangleGridIndex( i, j ) ] = coarse[ triangleGridIndex( i / 2, j / 2 ) ];
+						continue;
+					}
+					// The ends of the edge are along the row, the column or the diagonal
+					size_t i0 = i % 2 == 0 ? i : i - 1;
+					size_t j0 = j % 2 == 0 ? j : j - 1;
+					size_t i1 = i % 2 == 0 ? i : i + 1;
+					size_t j1 = j % 2 == 0 ? j : j + 1;
+					uint32_t a = coarse[ triangleGridIndex( i0 / 2, j0 / 2 ) ];
+					uint32_t b = coarse[ triangleGridIndex( i1 / 2, j1 / 2 ) ];
+					uint32_t next		= (uint32_t)positions.size();
+					uint32_t midpoint	= cache.find( a, b, next );
+					if ( midpoint == next ) {
+						positions.push_back( ( positions[ a ] + positions[ b ] ).normalized() );
+						texCoords.push_back( ( texCoords[ a ] + texCoords[ b ] ) * 0.5f );
+					}
+					dst[ triangleGridIndex( i, j ) ] = midpoint;
+				}
+			}
+		}
+		grid.swap( fine );
+		edges	= edges * 2 + rows * rows * 60;
+		rows	= fineRows;
+	}
+
+	// Positions on a unit sphere are their own normals
+	for ( size_t v = 0; v < numVertices; v++ ) {
+		out.setVertex( v, positions[ v ], positions[ v ], texCoords[ v ] );
+	}
+
+	// The texture is mapped across each face of the net on its own, 
+	// so tangents are found from the triangles as for any mesh
+	size_t gridSize = triangleGridIndex( rows + 1, 0 );
+	if ( !out.mTangents.isNull() ) {
+		vector<Vec3f> directions( numVertices * 2, Vec3f::zero() );
+		for ( size_t f = 0; f < 20; f++ ) {
+			const uint32_t *face = &grid[ f * gridSize ];
+			for ( size_t i = 0; i < rows; i++ ) {
+				const uint32_t *row		= face + triangleGridIndex( i, 0 );
+				const uint32_t *next	= face + triangleGridIndex( i + 1, 0 );
+				for ( size_t j = 0; j <= i; j++ ) {
+					addTexCoordDirections( row[ j ], next[ j ], next[ j + 1 ], &positions[ 0 ], &texCoords[ 0 ], 
+						&directions[ 0 ] );
+					if ( j < i ) {
+						addTexCoordDirections( row[ j ], next[ j + 1 ], row[ j + 1 ], &positions[ 0 ], &texCoords[ 0 ], 
+							&directions[ 0 ] );
+					}
+				}
+			}
+		}
+		for ( size_t v = 0; v < numVertices; v++ ) {
+			out.setTangent( v, finishTangent( positions[ v ], directions[ v * 2 ], directions[ v * 2 + 1 ] ) );
+		}
+	}
+
+	// Rows i and i + 1 of a grid are joined by 2i + 1 triangles. A strip 
+	// along them starts from the end of the rows to keep the winding.
+	IndexWriter w( out );
+	for ( size_t f = 0; f < 20; f++ ) {
+		const uint32_t *face = &grid[ f * gridSize ];
+		for ( size_t i = 0; i < rows; i++ ) {
+			const uint32_t *row		= face + triangleGridIndex( i, 0 );
+			const uint32_t *next	= face + triangleGridIndex( i + 1, 0 );
+			if ( out.isStrip() ) {
+				w.beginStrip( next[ i + 1 ] );
+				w.add( next[ i + 1 ] );
+				for ( size_t j = i + 1; j-- > 0; ) {
+					w.add( row[ j ] );
+					w.add( next[ j ] );
+				}
+				continue;
+			}
+			for ( size_t j = 0; j <= i; j++ ) {
+				w.add( row[ j ] );
+				w.add( next[ j ] );
+				w.add( next[ j + 1 ] );
+				if ( j < i ) {
+					w.add( row[ j ] );
+					w.add( next[ j + 1 ] );
+					w.add( row[ j + 1 ] );
+				}
+			}
+		}
+	}
+}
+
+// Writes the vertices of rows [ rowBegin, rowEnd ) of a plane, and the 
+// quads between each of those rows and the next
+void generatePlaneRows( uint32_t hSegments, uint32_t vSegments, uint32_t rowBegin, uint32_t rowEnd, 
+	const Output &out )
+{
+	Vec3f norm0( 0.0f, 0.0f, 1.0f );
+
+	for ( uint32_t y = rowBegin; y < rowEnd; y++ ) {
+		uint32_t v = y * hSegments;
+		float yRat = (float)y / (float)( vSegments - 1 );
+		fillLine( out.positions( v ), hSegments, (float)( hSegments - 1 ), Vec3f( -0.5f, yRat - 0.5f, 0.0f ), 
+			Vec3f( 1.0f, 0.0f, 0.0f ) );
+		fillConstant( out.normals( v ), hSegments, norm0 );
+		fillLine( out.texCoords( v ), hSegments, (float)( hSegments - 1 ), Vec2f( 0.0f, yRat ), Vec2f( 1.0f, 0.0f ) );
+		fillConstant( out.tangents( v ), hSegments, orientTangent( norm0, Vec3f::xAxis(), Vec3f::yAxis() ) );
+	}
+
+	writeGridRows( 0, hSegments, vSegments, rowBegin, rowEnd, IndexWriter( out ) );
+}
+
+// Runs generatePlaneRows() over a band of rows for parallelFor()
+struct PlaneJob
+{
+	uint32_t	mHSegments;
+	uint32_t	mVSegments;
+	Output		mOut;
+
+	void operator()( size_t begin, size_t end )
+	{
+		generatePlaneRows( mHSegments, mVSegments, (uint32_t)begin, (uint32_t)end, mOut );
+	}
+};
+
+// Planes are split into bands of rows filling disjoint ranges of the output. 
+// Every vertex and index is computed the same way regardless of banding, so 
+// the result is identical for any thread count.
+void generatePlane( uint32_t hSegments, uint32_t vSegments, uint32_t numThreads, const Output &out )
+{
+	static const size_t kMinVerticesPerBand = 16384;
+
+	PlaneJob job;
+	job.mHSegments	= hSegments;
+	job.mVSegments	= vSegments;
+	job.mOut		= out;
+
+	size_t grain	= std::max<size_t>( kMinVerticesPerBand / std::max<uint32_t>( hSegments, 1 ), 1 );
+	numThreads		= getNumThreads( numThreads );
+	grain			= std::max<size_t>( grain, vSegments / ( numThreads * 4 ) );
+	parallelFor( vSegments, grain, numThreads, job );
+}
+
+// Writes the vertices of rows [ rowBegin, rowEnd ) of a torus, each a circle around 
+// the Z axis at one angle around the tube, and the quads between them and the next
+void generateTorusRows( uint32_t majorSegments, uint32_t minorSegments, float majorRadius, float minorRadius, 
+	const Vec2f *majorTable, const Vec2f *minorTable, uint32_t rowBegin, uint32_t rowEnd, const Output &out )
+{
+	uint32_t columns = majorSegments + 1;
+	for ( uint32_t y = rowBegin; y < rowEnd; y++ ) {
+		uint32_t v		= y * columns;
+		float cosP		= minorTable[ y ].x;
+		float sinP		= minorTable[ y ].y;
+		float radius	= majorRadius + minorRadius * cosP;
+		fillRing( out.positions( v ), majorTable, columns, Vec3f( radius, 0.0f, 0.0f ), Vec3f( 0.0f, radius, 0.0f ), 
+			Vec3f( 0.0f, 0.0f, minorRadius * sinP ) );
+		fillRing( out.normals( v ), majorTable, columns, Vec3f( cosP, 0.0f, 0.0f ), Vec3f( 0.0f, cosP, 0.0f ), 
+			Vec3f( 0.0f, 0.0f, sinP ) );
+		fillLine( out.texCoords( v ), columns, (float)majorSegments, Vec2f( 0.0f, (float)y / (float)minorSegments ), 
+			Vec2f( 1.0f, 0.0f ) );
+		fillRing( out.tangents( v ), majorTable, columns, Vec3f( 0.0f, 1.0f, 0.0f ), Vec3f( -1.0f, 0.0f, 0.0f ), 1.0f );
+	}
+
+	writeGridRows( 0, columns, minorSegments + 1, rowBegin, rowEnd, IndexWriter( out ) );
+}
+
+// Runs generateTorusRows() over a band of rows for parallelFor()
+struct TorusJob
+{
+	uint32_t		mMajorSegments;
+	uint32_t		mMinorSegments;
+	float			mMajorRadius;
+	float			mMinorRadius;
+	CircleTableRef	mMajorTable;
+	CircleTableRef	mMinorTable;
+	Output			mOut;
+
+	void operator()( size_t begin, size_t end )
+	{
+		generateTorusRows( mMajorSegments, mMinorSegments, mMajorRadius, mMinorRadius, &( *mMajorTable )[ 0 ], 
+			&( *mMinorTable )[ 0 ], (uint32_t)begin, (uint32_t)end, mOut );
+	}
+};
+
+// A torus is a grid wrapped around both ways, repeating its first row 
+// and column at the texture seams. It is generated in bands of rows 
+// like a plane, and is identical for any thread count.
+void generateTorus( uint32_t majorSegments, uint32_t minorSegments, float majorRadius, float minorRadius, 
+	uint32_t numThreads, const Output &out )
+{
+	static const size_t kMinVerticesPerBand = 16384;
+
+	TorusJob job;
+	job.mMajorSegments	= majorSegments;
+	job.mMinorSegments	= minorSegments;
+	job.mMajorRadius	= majorRadius;
+	job.mMinorRadius	= minorRadius;
+	job.mMajorTable		= getCircleTable( majorSegments );
+	job.mMinorTable		= getCircleTable( minorSegments );
+	job.mOut			= out;
+
+	size_t grain	= std::max<size_t>( kMinVerticesPerBand / ( majorSegments + 1 ), 1 );
+	numThreads		= getNumThreads( numThreads );
+	grain			= std::max<size_t>( grain, ( minorSegments + 1 ) / ( numThreads * 4 ) );
+	parallelFor( minorSegments + 1, grain, numThreads, job );
+}
+
+}
+
+void MeshHelper::setSimdEnabled( bool enabled )
+{
+	sSimdEnabled = enabled;
+}
+
+bool MeshHelper::isSimdEnabled()
+{
+	return useSimd();
+}
+
+MeshHelper::Primitive::Primitive( PrimitiveType type )
+	: mType( type ), mSegments( 12 ), mRings( 2 ), mLayers( 1 ), mTopRadius( 1.0f ), mBaseRadius( 1.0f ), 
+	mSecondRadius( 0.5f ), mCloseTop( true ), mCloseBase( true )
+{
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::circle( uint32_t segments )
+{
+	Primitive primitive( PRIMITIVE_CIRCLE );
+	primitive.mSegments = segments;
+	return primitive;
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::cone( uint32_t segments, bool closeBase, uint32_t layers )
+{
+	Primitive primitive( PRIMITIVE_CONE );
+	primitive.mSegments		= segments;
+	primitive.mLayers		= std::max<uint32_t>( layers, 1 );
+	primitive.mCloseBase	= closeBase;
+	return primitive;
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::cube( uint32_t subdivisions )
+{
+	Primitive primitive( PRIMITIVE_CUBE );
+	primitive.mLayers = std::max<uint32_t>( subdivisions, 1 );
+	return primitive;
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::cylinder( uint32_t segments, float topRadius, float baseRadius, 
+	bool closeTop, bool closeBase, uint32_t layers )
+{
+	Primitive primitive( PRIMITIVE_CYLINDER );
+	primitive.mSegments		= segments;
+	primitive.mLayers		= std::max<uint32_t>( layers, 1 );
+	primitive.mTopRadius	= topRadius;
+	primitive.mBaseRadius	= baseRadius;
+	primitive.mCloseTop		= closeTop;
+	primitive.mCloseBase	= closeBase;
+	return primitive;
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::ring( uint32_t segments, float secondRadius )
+{
+	Primitive primitive( PRIMITIVE_RING );
+	primitive.mSegments		= segments;
+	primitive.mSecondRadius	= secondRadius;
+	return primitive;
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::sphere( uint32_t segments, uint32_t rings )
+{
+	Primitive primitive( PRIMITIVE_SPHERE );
+	primitive.mSegments = std::max<uint32_t>( segments, 3 );
+	primitive.mRings	= std::max<uint32_t>( rings > 0 ? rings : segments / 2, 2 );
+	return primitive;
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::plane( uint32_t hSegments, uint32_t vSegments )
+{
+	// Both counts are of vertices, so a plane needs two along each edge
+	Primitive primitive( PRIMITIVE_PLANE );
+	primitive.mSegments	= std::max<uint32_t>( hSegments, 2 );
+	primitive.mRings	= std::max<uint32_t>( vSegments, 2 );
+	return primitive;
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::icosphere( uint32_t subdivisions )
+{
+	Primitive primitive( PRIMITIVE_ICOSPHERE );
+	primitive.mSegments = subdivisions;
+	return primitive;
+}
+
+MeshHelper::Primitive MeshHelper::Primitive::torus( uint32_t majorSegments, uint32_t minorSegments, float majorRadius, 
+	float minorRadius )
+{
+	Primitive primitive( PRIMITIVE_TORUS );
+	primitive.mSegments		= std::max<uint32_t>( majorSegments, 3 );
+	primitive.mRings		= std::max<uint32_t>( minorSegments, 3 );
+	primitive.mTopRadius	= majorRadius;
+	primitive.mSecondRadius	= minorRadius;
+	return primitive;
+}
+
+bool MeshHelper::Primitive::operator<( const Primitive &rhs ) const
+{
+	if ( mType != rhs.mType ) {
+		return mType < rhs.mType;
+	}
+	if ( mSegments != rhs.mSegments ) {
+		return mSegments < rhs.mSegments;
+	}
+	if ( mRings != rhs.mRings ) {
+		return mRings < rhs.mRings;
+	}
+	if ( mLayers != rhs.mLayers ) {
+		return mLayers < rhs.mLayers;
+	}
+	if ( mTopRadius != rhs.mTopRadius ) {
+		return mTopRadius < rhs.mTopRadius;
+	}
+	if ( mBaseRadius != rhs.mBaseRadius ) {
+		return mBaseRadius < rhs.mBaseRadius;
+	}
+	if ( mSecondRadius != rhs.mSecondRadius ) {
+		return mSecondRadius < rhs.mSecondRadius;
+	}
+	if ( mCloseTop != rhs.mCloseTop ) {
+		return rhs.mCloseTop;
+	}
+	return mCloseBase != rhs.mCloseBase && rhs.mCloseBase;
+}
+
+bool MeshHelper::Primitive::operator==( const Primitive &rhs ) const
+{
+	return mType == rhs.mType && mSegments == rhs.mSegments && mRings == rhs.mRings && 
+		mLayers == rhs.mLayers && mTopRadius == rhs.mTopRadius && mBaseRadius == rhs.mBaseRadius && 
+		mSecondRadius == rhs.mSecondRadius && mCloseTop == rhs.mCloseTop && mCloseBase == rhs.mCloseBase;
+}
+
+void MeshHelper::calcSize( const Primitive &primitive, size_t *numVertices, size_t *numIndices, Topology topology )
+{
+	size_t segments	= primitive.getSegments();
+	size_t layers	= primitive.getLayers();
+	if ( topology != TOPOLOGY_TRIANGLES ) {
+		// Vertices are the same as for triangles. Indices are counted 
+		// strip by strip, in the order the generators write them.
+		calcSize( primitive, numVertices, numIndices );
+		*numIndices = 0;
+		switch ( primitive.getType() ) {
+		case PRIMITIVE_CIRCLE:
+			IndexWriter::countStrip( segments, topology, numIndices );
+			break;
+		case PRIMITIVE_CONE:
+			IndexWriter::countStrip( segments * 2 + 1, topology, numIndices );
+			for ( size_t y = 1; y < layers; y++ ) {
+				IndexWriter::countStrip( ( segments + 1 ) * 2, topology, numIndices );
+			}
+			if ( primitive.getCloseBase() ) {
+				IndexWriter::countStrip( segments, topology, numIndices );
+			}
+			break;
+		case PRIMITIVE_CUBE:
+			for ( size_t y = 0; y < layers * 6; y++ ) {
+				IndexWriter::countStrip( ( layers + 1 ) * 2, topology, numIndices );
+			}
+			break;
+		case PRIMITIVE_CYLINDER:
+			if ( primitive.getCloseTop() ) {
+				IndexWriter::countStrip( segments, topology, numIndices );
+			}
+			for ( size_t y = 0; y < layers; y++ ) {
+				IndexWriter::countStrip( ( segments + 1 ) * 2, topology, numIndices );
+			}
+			if ( primitive.getCloseBase() ) {
+				IndexWriter::countStrip( segments, topology, numIndices );
+			}
+			break;
+		case PRIMITIVE_RING:
+			IndexWriter::countStrip( ( segments + 1 ) * 2, topology, numIndices );
+			break;
+		case PRIMITIVE_SPHERE:
+			IndexWriter::countStrip( segments * 2 + 1, topology, numIndices );
+			for ( size_t p = 1; p + 1 < primitive.getRings(); p++ ) {
+				IndexWriter::countStrip( ( segments + 1 ) * 2, topology, numIndices );
+			}
+			IndexWriter::countStrip( segments * 2 + 1, topology, numIndices );
+			break;
+		case PRIMITIVE_PLANE:
+			if ( segments > 1 ) {
+				for ( size_t y = 0; y + 1 < primitive.getRings(); y++ ) {
+					IndexWriter::countStrip( segments * 2, topology, numIndices );
+				}
+			}
+			break;
+		case PRIMITIVE_ICOSPHERE:
+			for ( size_t f = 0; f < 20; f++ ) {
+				for ( size_t i = 0; i < ( (size_t)1 << segments ); i++ ) {
+					IndexWriter::countStrip( i * 2 + 3, topology, numIndices );
+				}
+			}
+			break;
+		case PRIMITIVE_TORUS:
+			for ( size_t y = 0; y < primitive.getRings(); y++ ) {
+				IndexWriter::countStrip( ( segments + 1 ) * 2, topology, numIndices );
+			}
+			break;
+		}
+		return;
+	}
+
+	switch ( primitive.getType() ) {
+	case PRIMITIVE_CIRCLE:
+		*numVertices	= segments + 1;
+		*numIndices		= segments * 3;
+		break;
+	case PRIMITIVE_CONE:
+		*numVertices	= segments + ( segments + 1 ) * layers;
+		*numIndices		= segments * 3 + segments * ( layers - 1 ) * 6;
+		if ( primitive.getCloseBase() ) {
+			*numVertices	+= segments + 1;
+			*numIndices		+= segments * 3;
+		}
+		break;
+	case PRIMITIVE_CUBE:
+		*numVertices	= ( layers + 1 ) * ( layers + 1 ) * 6;
+		*numIndices		= layers * layers * 36;
+		break;
+	case PRIMITIVE_CYLINDER:
+		{
+			size_t caps		= ( primitive.getCloseTop() ? 1 : 0 ) + ( primitive.getCloseBase() ? 1 : 0 );
+			*numVertices	= ( segments + 1 ) * ( layers + 1 + caps );
+			*numIndices		= segments * ( layers * 6 + caps * 3 );
+		}
+		break;
+	case PRIMITIVE_RING:
+		*numVertices	= segments * 2;
+		*numIndices		= segments * 6;
+		break;
+	case PRIMITIVE_SPHERE:
+		*numVertices	= segments * 2 + ( primitive.getRings() - 1 ) * ( segments + 1 );
+		*numIndices		= ( primitive.getRings() - 1 ) * segments * 6;
+		break;
+	case PRIMITIVE_PLANE:
+		*numVertices	= segments * primitive.getRings();
+		*numIndices		= ( segments - 1 ) * ( primitive.getRings() - 1 ) * 6;
+		break;
+	case PRIMITIVE_ICOSPHERE:
+		{
+			size_t numEdges = 0;
+			calcIcosphereSize( (uint32_t)segments, numVertices, &numEdges, numIndices );
+			*numIndices *= 3;
+		}
+		break;
+	case PRIMITIVE_TORUS:
+		*numVertices	= ( segments + 1 ) * ( primitive.getRings() + 1 );
+		*numIndices		= segments * primitive.getRings() * 6;
+		break;
+	}
+}
+
+AxisAlignedBox3f MeshHelper::calcBounds( const Primitive &primitive )
+{
+	switch ( primitive.getType() ) {
+	case PRIMITIVE_CIRCLE:
+		return AxisAlignedBox3f( Vec3f( -1.0f, -1.0f, 0.0f ), Vec3f( 1.0f, 1.0f, 0.0f ) );
+	case PRIMITIVE_CONE:
+		return AxisAlignedBox3f( Vec3f( -1.0f, -0.5f, -1.0f ), Vec3f( 1.0f, 0.5f, 1.0f ) );
+	case PRIMITIVE_CUBE:
+		return AxisAlignedBox3f( Vec3f::one() * -0.5f, Vec3f::one() * 0.5f );
+	case PRIMITIVE_CYLINDER:
+		{
+			float radius = math<float>::max( math<float>::abs( primitive.getTopRadius() ), 
+				math<float>::abs( primitive.getBaseRadius() ) );
+			return AxisAlignedBox3f( Vec3f( -radius, -0.5f, -radius ), Vec3f( radius, 0.5f, radius ) );
+		}
+	case PRIMITIVE_RING:
+		{
+			float radius = math<float>::max( 1.0f, math<float>::abs( primitive.getSecondRadius() ) );
+			return AxisAlignedBox3f( Vec3f( -radius, -radius, 0.0f ), Vec3f( radius, radius, 0.0f ) );
+		}
+	case PRIMITIVE_SPHERE:
+	case PRIMITIVE_ICOSPHERE:
+		return AxisAlignedBox3f( -Vec3f::one(), Vec3f::one() );
+	case PRIMITIVE_PLANE:
+		return AxisAlignedBox3f( Vec3f( -0.5f, -0.5f, 0.0f ), Vec3f( 0.5f, 0.5f, 0.0f ) );
+	case PRIMITIVE_TORUS:
+		{
+			float minorRadius	= math<float>::abs( primitive.getSecondRadius() );
+			float radius		= math<float>::abs( primitive.getTopRadius() ) + minorRadius;
+			return AxisAlignedBox3f( Vec3f( -radius, -radius, -minorRadius ), Vec3f( radius, radius, minorRadius ) );
+		}
+	}
+	return AxisAlignedBox3f( Vec3f::zero(), Vec3f::zero() );
+}
+
+namespace
+{
+
+// Runs the generator for primitive
+void generateOutput( const MeshHelper::Primitive &primitive, uint32_t numThreads, const Output &out )
+{
+	switch ( primitive.getType() ) {
+	case MeshHelper::PRIMITIVE_CIRCLE:
+		generateCircle( primitive.getSegments(), out );
+		break;
+	case MeshHelper::PRIMITIVE_CONE:
+		generateCone( primitive.getSegments(), primitive.getCloseBase(), primitive.getLayers(), numThreads, out );
+		break;
+	case MeshHelper::PRIMITIVE_CUBE:
+		generateCube( primitive.getLayers(), numThreads, out );
+		break;
+	case MeshHelper::PRIMITIVE_CYLINDER:
+		generateCylinder( primitive.getSegments(), primitive.getTopRadius(), primitive.getBaseRadius(), 
+			primitive.getCloseTop(), primitive.getCloseBase(), primitive.getLayers(), numThreads, out );
+		break;
+	case MeshHelper::PRIMITIVE_RING:
+		generateRing( primitive.getSegments(), primitive.getSecondRadius(), out );
+		break;
+	case MeshHelper::PRIMITIVE_SPHERE:
+		generateSphere( primitive.getSegments(), primitive.getRings(), out );
+		break;
+	case MeshHelper::PRIMITIVE_PLANE:
+		generatePlane( primitive.getSegments(), primitive.getRings(), numThreads, out );
+		break;
+	case MeshHelper::PRIMITIVE_ICOSPHERE:
+		generateIcosphere( primitive.getSegments(), out );
+		break;
+	case MeshHelper::PRIMITIVE_TORUS:
+		generateTorus( primitive.getSegments(), primitive.getRings(), primitive.getTopRadius(), 
+			primitive.getSecondRadius(), numThreads, out );
+		break;
+	}
+}
+
+// Number of components in each vertex layout attribute
+const size_t kAttribComponents[ 3 ] = { 3, 3, 2 };
+
+inline size_t alignUp( size_t size, size_t alignment )
+{
+	return ( ( size + alignment - 1 ) / alignment ) * alignment;
+}
+
+inline uint32_t asUint( float f )
+{
+	uint32_t u;
+	memcpy( &u, &f, sizeof( u ) );
+	return u;
+}
+
+inline float asFloat( uint32_t u )
+{
+	float f;
+	memcpy( &f, &u, sizeof( f ) );
+	return f;
+}
+
+// Encoders for compressed vertex formats. Like the fill kernels, the SIMD 
+// and scalar paths perform the same operations in the same order, so the 
+// encoded bits don't depend on the path taken.
+
+// Float bit patterns at and above which a half overflows, below which it 
+// is subnormal, the magic number that rounds subnormals into place, and 
+// the exponent rebias with rounding bias for normal numbers
+const uint32_t kHalfOverflow		= ( 127 + 16 ) << 23;
+const uint32_t kHalfNormalMin		= ( 127 - 14 ) << 23;
+const uint32_t kHalfDenormMagic		= ( ( 127 - 15 ) + ( 23 - 10 ) + 1 ) << 23;
+const uint32_t kHalfRebias			= 0xfffu - ( ( 127 - 15 ) << 23 );
+
+// Float to half, rounding to nearest even. NaNs stay NaNs.
+inline uint16_t encodeHalf( float f )
+{
+	uint32_t u		= asUint( f );
+	uint32_t sign	= u & 0x80000000u;
+	u				^= sign;
+
+	uint32_t h = 0;
+	if ( u >= kHalfOverflow ) {
+		h = u > 0x7f800000u ? 0x7e00u : 0x7c00u;
+	} else if ( u < kHalfNormalMin ) {
+		// Adding the magic number lines the mantissa up at the bottom 
+		// of the float, with the FPU rounding it to nearest even
+		h = asUint( asFloat( u ) + asFloat( kHalfDenormMagic ) ) - kHalfDenormMagic;
+	} else {
+		uint32_t odd = ( u >> 13 ) & 1;
+		h = ( ( u + kHalfRebias ) + odd ) >> 13;
+	}
+	return (uint16_t)( h | ( sign >> 16 ) );
+}
+
+inline float decodeHalf( uint16_t h )
+{
+	uint32_t sign	= (uint32_t)( h & 0x8000 ) << 16;
+	uint32_t bits	= h & 0x7fff;
+	if ( bits >= 0x7c00 ) {
+		return asFloat( sign | 0x7f800000u | ( ( bits & 0x03ff ) << 13 ) );
+	}
+	if ( bits >= 0x0400 ) {
+		return asFloat( sign | ( ( bits << 13 ) + ( ( 127 - 15 ) << 23 ) ) );
+	}
+	return asFloat( sign | asUint( (float)bits * ( 1.0f / 16777216.0f ) ) );
+}
+
+// ( value - offset ) * scale, clamped to [ 0, 1 ] and rounded to 16 bits
+inline uint16_t encodeUnorm16( float value, float offset, float scale )
+{
+	float v = std::min( std::max( ( value - offset ) * scale, 0.0f ), 1.0f );
+	return (uint16_t)(int32_t)( v * 65535.0f + 0.5f );
+}
+
+inline float decodeUnorm16( uint16_t value )
+{
+	return (float)value / 65535.0f;
+}
+
+inline float signNotZero( float v )
+{
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+// Octahedral coordinates of a unit vector, rounded to 16-bit signed normalized
+inline void encodeOctahedral( const Vec3f &n, int16_t *dst )
+{
+	float l1	= std::max( ( math<float>::abs( n.x ) + math<float>::abs( n.y ) ) + math<float>::abs( n.z ), FLT_MIN );
+	float x		= n.x / l1;
+	float y		= n.y / l1;
+	if ( n.z < 0.0f ) {
+		float fx	= ( 1.0f - math<float>::abs( y ) ) * signNotZero( x );
+		float fy	= ( 1.0f - math<float>::abs( x ) ) * signNotZero( y );
+		x			= fx;
+		y			= fy;
+	}
+	dst[ 0 ] = (int16_t)(int32_t)( x * 32767.0f + ( x >= 0.0f ? 0.5f : -0.5f ) );
+	dst[ 1 ] = (int16_t)(int32_t)( y * 32767.0f + ( y >= 0.0f ? 0.5f : -0.5f ) );
+}
+
+inline Vec3f decodeOctahedral( const int16_t *src )
+{
+	float x = std::max( (float)src[ 0 ] / 32767.0f, -1.0f );
+	float y = std::max( (float)src[ 1 ] / 32767.0f, -1.0f );
+	float z = 1.0f - math<float>::abs( x ) - math<float>::abs( y );
+	if ( z < 0.0f ) {
+		float fx	= ( 1.0f - math<float>::abs( y ) ) * signNotZero( x );
+		float fy	= ( 1.0f - math<float>::abs( x ) ) * signNotZero( y );
+		x			= fx;
+		y			= fy;
+	}
+	return Vec3f( x, y, z ).normalized();
+}
+
+#if defined( MESHHELPER_SSE )
+
+inline __m128i select( __m128i mask, __m128i a, __m128i b )
+{
+	return _mm_or_si128( _mm_and_si128( mask, a ), _mm_andnot_si128( mask, b ) );
+}
+
+inline __m128 select( __m128 mask, __m128 a, __m128 b )
+{
+	return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) );
+}
+
+inline __m128 abs4( __m128 v )
+{
+	return _mm_and_ps( v, _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) ) );
+}
+
+// encodeHalf() on four floats, leaving each half in the low bits of a lane
+inline __m128i encodeHalf4( __m128 f )
+{
+	__m128i u		= _mm_castps_si128( f );
+	__m128i sign	= _mm_and_si128( u, _mm_set1_epi32( (int32_t)0x80000000u ) );
+	u				= _mm_xor_si128( u, sign );
+
+	// With the sign cleared, signed compares order the bits as unsigned ones
+	__m128i overflow	= _mm_cmpgt_epi32( u, _mm_set1_epi32( (int32_t)kHalfOverflow - 1 ) );
+	__m128i nan			= _mm_cmpgt_epi32( u, _mm_set1_epi32( 0x7f800000 ) );
+	__m128i inf			= _mm_or_si128( _mm_set1_epi32( 0x7c00 ), _mm_and_si128( nan, _mm_set1_epi32( 0x0200 ) ) );
+	__m128i denormal	= _mm_cmpgt_epi32( _mm_set1_epi32( (int32_t)kHalfNormalMin ), u );
+	__m128i magic		= _mm_set1_epi32( (int32_t)kHalfDenormMagic );
+	__m128i small		= _mm_sub_epi32( _mm_castps_si128( _mm_add_ps( _mm_castsi128_ps( u ), 
+		_mm_castsi128_ps( magic ) ) ), magic );
+	__m128i odd			= _mm_and_si128( _mm_srli_epi32( u, 13 ), _mm_set1_epi32( 1 ) );
+	__m128i normal		= _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( u, _mm_set1_epi32( (int32_t)kHalfRebias ) ), 
+		odd ), 13 );
+	return _mm_or_si128( select( overflow, inf, select( denormal, small, normal ) ), _mm_srli_epi32( sign, 16 ) );
+}
+
+// encodeUnorm16() on four floats
+inline __m128i encodeUnorm16x4( __m128 value, __m128 offset, __m128 scale )
+{
+	__m128 v = _mm_min_ps( _mm_max_ps( _mm_mul_ps( _mm_sub_ps( value, offset ), scale ), _mm_setzero_ps() ), 
+		_mm_set1_ps( 1.0f ) );
+	return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( v, _mm_set1_ps( 65535.0f ) ), _mm_set1_ps( 0.5f ) ) );
+}
+
+// Rounds four floats in [ -1, 1 ] to 16-bit signed normalized
+inline __m128i encodeSnorm16x4( __m128 v )
+{
+	__m128 half = select( _mm_cmpge_ps( v, _mm_setzero_ps() ), _mm_set1_ps( 0.5f ), _mm_set1_ps( -0.5f ) );
+	return _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( v, _mm_set1_ps( 32767.0f ) ), half ) );
+}
+
+#elif defined( MESHHELPER_NEON )
+
+inline uint32x4_t encodeHalf4( float32x4_t f )
+{
+	uint32x4_t u	= vreinterpretq_u32_f32( f );
+	uint32x4_t sign	= vandq_u32( u, vdupq_n_u32( 0x80000000u ) );
+	u				= veorq_u32( u, sign );
+
+	uint32x4_t overflow	= vcgeq_u32( u, vdupq_n_u32( kHalfOverflow ) );
+	uint32x4_t inf		= vbslq_u32( vcgtq_u32( u, vdupq_n_u32( 0x7f800000u ) ), vdupq_n_u32( 0x7e00u ), 
+		vdupq_n_u32( 0x7c00u ) );
+	uint32x4_t denormal	= vcltq_u32( u, vdupq_n_u32( kHalfNormalMin ) );
+	uint32x4_t magic	= vdupq_n_u32( kHalfDenormMagic );
+	uint32x4_t small	= vsubq_u32( vreinterpretq_u32_f32( vaddq_f32( vreinterpretq_f32_u32( u ), 
+		vreinterpretq_f32_u32( magic ) ) ), magic );
+	uint32x4_t odd		= vandq_u32( vshrq_n_u32( u, 13 ), vdupq_n_u32( 1 ) );
+	uint32x4_t normal	= vshrq_n_u32( vaddq_u32( vaddq_u32( u, vdupq_n_u32( kHalfRebias ) ), odd ), 13 );
+	return vorrq_u32( vbslq_u32( overflow, inf, vbslq_u32( denormal, small, normal ) ), vshrq_n_u32( sign, 16 ) );
+}
+
+inline uint32x4_t encodeUnorm16x4( float32x4_t value, float32x4_t offset, float32x4_t scale )
+{
+	float32x4_t v = vminq_f32( vmaxq_f32( vmulq_f32( vsubq_f32( value, offset ), scale ), vdupq_n_f32( 0.0f ) ), 
+		vdupq_n_f32( 1.0f ) );
+	return vreinterpretq_u32_s32( vcvtq_s32_f32( vaddq_f32( vmulq_n_f32( v, 65535.0f ), vdupq_n_f32( 0.5f ) ) ) );
+}
+
+inline int32x4_t encodeSnorm16x4( float32x4_t v )
+{
+	float32x4_t half = vbslq_f32( vcgeq_f32( v, vdupq_n_f32( 0.0f ) ), vdupq_n_f32( 0.5f ), vdupq_n_f32( -0.5f ) );
+	return vcvtq_s32_f32( vaddq_f32( vmulq_n_f32( v, 32767.0f ), half ) );
+}
+
+#endif
+
+// Encodes count elements of numComponents floats each to halves, written 
+// to elements stride bytes apart
+void encodeHalf( const float *src, size_t count, size_t numComponents, uint8_t *dst, size_t stride )
+{
+	size_t i = 0;
+	if ( useSimd() ) {
+#if defined( MESHHELPER_SSE ) || defined( MESHHELPER_NEON )
+		// Four elements are numComponents full vectors
+		uint32_t lanes[ 12 ];
+		uint16_t block[ 12 ];
+		for ( ; i + 4 <= count; i += 4 ) {
+			for ( size_t k = 0; k < numComponents; k++ ) {
+#if defined( MESHHELPER_SSE )
+				_mm_storeu_si128( (__m128i *)( lanes + k * 4 ), encodeHalf4( _mm_loadu_ps( src + i * numComponents + k * 4 ) ) );
+#else
+				vst1q_u32( lanes + k * 4, encodeHalf4( vld1q_f32( src + i * numComponents + k * 4 ) ) );
+#endif
+			}
+			for ( size_t k = 0; k < numComponents * 4; k++ ) {
+				block[ k ] = (uint16_t)lanes[ k ];
+			}
+			for ( size_t e = 0; e < 4; e++ ) {
+				memcpy( dst + ( i + e ) * stride, block + e * numComponents, numComponents * sizeof( uint16_t ) );
+			}
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		uint16_t element[ 3 ];
+		for ( size_t c = 0; c < numComponents; c++ ) {
+			element[ c ] = encodeHalf( src[ i * numComponents + c ] );
+		}
+		memcpy( dst + i * stride, element, numComponents * sizeof( uint16_t ) );
+	}
+}
+
+// Encodes count elements of numComponents floats each to 16-bit unsigned 
+// normalized, after applying a per component offset and scale
+void encodeUnorm16( const float *src, size_t count, size_t numComponents, const float *offset, const float *scale, 
+	uint8_t *dst, size_t stride )
+{
+	size_t i = 0;
+	if ( useSimd() ) {
+#if defined( MESHHELPER_SSE ) || defined( MESHHELPER_NEON )
+		// Lane k of the vectors covering four elements holds component k % numComponents
+		float laneOffsets[ 12 ];
+		float laneScales[ 12 ];
+		for ( size_t k = 0; k < numComponents * 4; k++ ) {
+			laneOffsets[ k ]	= offset[ k % numComponents ];
+			laneScales[ k ]		= scale[ k % numComponents ];
+		}
+		uint32_t lanes[ 12 ];
+		uint16_t block[ 12 ];
+		for ( ; i + 4 <= count; i += 4 ) {
+			for ( size_t k = 0; k < numComponents; k++ ) {
+#if defined( MESHHELPER_SSE )
+				_mm_storeu_si128( (__m128i *)( lanes + k * 4 ), encodeUnorm16x4( _mm_loadu_ps( src + i * numComponents + k * 4 ), 
+					_mm_loadu_ps( laneOffsets + k * 4 ), _mm_loadu_ps( laneScales + k * 4 ) ) );
+#else
+				vst1q_u32( lanes + k * 4, encodeUnorm16x4( vld1q_f32( src + i * numComponents + k * 4 ), 
+					vld1q_f32( laneOffsets + k * 4 ), vld1q_f32( laneScales + k * 4 ) ) );
+#endif
+			}
+			for ( size_t k = 0; k < numComponents * 4; k++ ) {
+				block[ k ] = (uint16_t)lanes[ k ];
+			}
+			for ( size_t e = 0; e < 4; e++ ) {
+				memcpy( dst + ( i + e ) * stride, block + e * numComponents, numComponents * sizeof( uint16_t ) );
+			}
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		uint16_t element[ 3 ];
+		for ( size_t c = 0; c < numComponents; c++ ) {
+			element[ c ] = encodeUnorm16( src[ i * numComponents + c ], offset[ c ], scale[ c ] );
+		}
+		memcpy( dst + i * stride, element, numComponents * sizeof( uint16_t ) );
+	}
+}
+
+// Encodes count unit vectors to octahedral coordinates
+void encodeOctahedral( const Vec3f *src, size_t count, uint8_t *dst, size_t stride )
+{
+	size_t i = 0;
+	if ( useSimd() ) {
+#if defined( MESHHELPER_SSE )
+		int32_t lanes[ 8 ];
+		for ( ; i + 4 <= count; i += 4 ) {
+			const Vec3f *n	= src + i;
+			__m128 x		= _mm_set_ps( n[ 3 ].x, n[ 2 ].x, n[ 1 ].x, n[ 0 ].x );
+			__m128 y		= _mm_set_ps( n[ 3 ].y, n[ 2 ].y, n[ 1 ].y, n[ 0 ].y );
+			__m128 z		= _mm_set_ps( n[ 3 ].z, n[ 2 ].z, n[ 1 ].z, n[ 0 ].z );
+			__m128 l1		= _mm_max_ps( _mm_add_ps( _mm_add_ps( abs4( x ), abs4( y ) ), abs4( z ) ), _mm_set1_ps( FLT_MIN ) );
+			x				= _mm_div_ps( x, l1 );
+			y				= _mm_div_ps( y, l1 );
+
+			__m128 one		= _mm_set1_ps( 1.0f );
+			__m128 zero		= _mm_setzero_ps();
+			__m128 fx		= _mm_mul_ps( _mm_sub_ps( one, abs4( y ) ), select( _mm_cmpge_ps( x, zero ), one, _mm_set1_ps( -1.0f ) ) );
+			__m128 fy		= _mm_mul_ps( _mm_sub_ps( one, abs4( x ) ), select( _mm_cmpge_ps( y, zero ), one, _mm_set1_ps( -1.0f ) ) );
+			__m128 fold		= _mm_cmplt_ps( z, zero );
+			_mm_storeu_si128( (__m128i *)lanes,			encodeSnorm16x4( select( fold, fx, x ) ) );
+			_mm_storeu_si128( (__m128i *)( lanes + 4 ),	encodeSnorm16x4( select( fold, fy, y ) ) );
+			for ( size_t e = 0; e < 4; e++ ) {
+				int16_t element[ 2 ] = { (int16_t)lanes[ e ], (int16_t)lanes[ e + 4 ] };
+				memcpy( dst + ( i + e ) * stride, element, sizeof( element ) );
+			}
+		}
+#elif defined( MESHHELPER_NEON )
+		// NEON has no exact vector divide on ARMv7, so the projection 
+		// divides are scalar
+		int32_t lanes[ 8 ];
+		float l1s[ 4 ];
+		float xs[ 4 ];
+		float ys[ 4 ];
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4x3_t n	= vld3q_f32( &src[ i ].x );
+			float32x4_t l1	= vmaxq_f32( vaddq_f32( vaddq_f32( vabsq_f32( n.val[ 0 ] ), vabsq_f32( n.val[ 1 ] ) ), 
+				vabsq_f32( n.val[ 2 ] ) ), vdupq_n_f32( FLT_MIN ) );
+			vst1q_f32( l1s, l1 );
+			for ( size_t e = 0; e < 4; e++ ) {
+				xs[ e ] = src[ i + e ].x / l1s[ e ];
+				ys[ e ] = src[ i + e ].y / l1s[ e ];
+			}
+			float32x4_t x	= vld1q_f32( xs );
+			float32x4_t y	= vld1q_f32( ys );
+
+			float32x4_t one		= vdupq_n_f32( 1.0f );
+			float32x4_t zero	= vdupq_n_f32( 0.0f );
+			float32x4_t fx		= vmulq_f32( vsubq_f32( one, vabsq_f32( y ) ), vbslq_f32( vcgeq_f32( x, zero ), one, vdupq_n_f32( -1.0f ) ) );
+			float32x4_t fy		= vmulq_f32( vsubq_f32( one, vabsq_f32( x ) ), vbslq_f32( vcgeq_f32( y, zero ), one, vdupq_n_f32( -1.0f ) ) );
+			uint32x4_t fold		= vcltq_f32( n.val[ 2 ], zero );
+			vst1q_s32( lanes,		encodeSnorm16x4( vbslq_f32( fold, fx, x ) ) );
+			vst1q_s32( lanes + 4,	encodeSnorm16x4( vbslq_f32( fold, fy, y ) ) );
+			for ( size_t e = 0; e < 4; e++ ) {
+				int16_t element[ 2 ] = { (int16_t)lanes[ e ], (int16_t)lanes[ e + 4 ] };
+				memcpy( dst + ( i + e ) * stride, element, sizeof( element ) );
+			}
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		int16_t element[ 2 ];
+		encodeOctahedral( src[ i ], element );
+		memcpy( dst + i * stride, element, sizeof( element ) );
+	}
+}
+
+// Encodes full precision scratch attributes into a compressed layout. 
+// Attributes stored as floats are generated in place and have no scratch.
+struct EncodeJob
+{
+	const MeshHelper::VertexLayout	*mLayout;
+	uint8_t							*mData;
+	size_t							mNumVertices;
+	const Vec3f						*mPositions;
+	const Vec3f						*mNormals;
+	const Vec2f						*mTexCoords;
+	float							mPositionOffset[ 3 ];
+	float							mPositionScale[ 3 ];
+
+	void operator()( size_t begin, size_t end ) const
+	{
+		typedef MeshHelper::VertexLayout Layout;
+		static const float kZero[ 2 ]	= { 0.0f, 0.0f };
+		static const float kOne[ 2 ]	= { 1.0f, 1.0f };
+
+		size_t count = end - begin;
+		if ( mPositions != 0 ) {
+			size_t stride	= mLayout->getStride( Layout::ATTRIB_POSITION );
+			uint8_t *dst	= mData + mLayout->getOffset( Layout::ATTRIB_POSITION, mNumVertices ) + begin * stride;
+			if ( mLayout->getFormat( Layout::ATTRIB_POSITION ) == Layout::FORMAT_HALF ) {
+				encodeHalf( &mPositions[ begin ].x, count, 3, dst, stride );
+			} else {
+				encodeUnorm16( &mPositions[ begin ].x, count, 3, mPositionOffset, mPositionScale, dst, stride );
+			}
+		}
+		if ( mNormals != 0 ) {
+			size_t stride	= mLayout->getStride( Layout::ATTRIB_NORMAL );
+			uint8_t *dst	= mData + mLayout->getOffset( Layout::ATTRIB_NORMAL, mNumVertices ) + begin * stride;
+			if ( mLayout->getFormat( Layout::ATTRIB_NORMAL ) == Layout::FORMAT_HALF ) {
+				encodeHalf( &mNormals[ begin ].x, count, 3, dst, stride );
+			} else {
+				encodeOctahedral( mNormals + begin, count, dst, stride );
+			}
+		}
+		if ( mTexCoords != 0 ) {
+			size_t stride	= mLayout->getStride( Layout::ATTRIB_TEX_COORD );
+			uint8_t *dst	= mData + mLayout->getOffset( Layout::ATTRIB_TEX_COORD, mNumVertices ) + begin * stride;
+			if ( mLayout->getFormat( Layout::ATTRIB_TEX_COORD ) == Layout::FORMAT_HALF ) {
+				encodeHalf( &mTexCoords[ begin ].x, count, 2, dst, stride );
+			} else {
+				encodeUnorm16( &mTexCoords[ begin ].x, count, 2, kZero, kOne, dst, stride );
+			}
+		}
+	}
+};
+
+}
+
+void MeshHelper::generate( const Primitive &primitive, uint32_t *indices, Vec3f *positions, 
+	Vec3f *normals, Vec2f *texCoords, uint32_t numThreads, Vec4f *tangents )
+{
+	// Meshes bigger than a typical last level cache would be evicted before 
+	// they're used anyway, so their SIMD stores bypass it
+	static const size_t kStreamBytes = 8 * 1024 * 1024;
+
+	size_t numVertices	= 0;
+	size_t numIndices	= 0;
+	calcSize( primitive, &numVertices, &numIndices );
+	bool stream			= numIndices * sizeof( uint32_t ) + 
+		numVertices * ( sizeof( Vec3f ) * 2 + sizeof( Vec2f ) + sizeof( Vec4f ) ) > kStreamBytes;
+
+	Output out;
+	out.mIndices		= indices;
+	out.mNormals		= Strided<Vec3f>( normals, sizeof( Vec3f ), stream );
+	out.mPositions		= Strided<Vec3f>( positions, sizeof( Vec3f ), stream );
+	out.mTexCoords		= Strided<Vec2f>( texCoords, sizeof( Vec2f ), stream );
+	out.mTangents		= Strided<Vec4f>( tangents, sizeof( Vec4f ), stream );
+	out.mStreamIndices	= stream;
+	generateOutput( primitive, numThreads, out );
+	fenceStreams();
+}
+
+MeshHelper::VertexLayout::VertexLayout()
+	: mInterleaved( false ), mMinStride( 0 ), mAlignment( 4 )
+{
+	mOrder[ 0 ]		= ATTRIB_POSITION;
+	mOrder[ 1 ]		= ATTRIB_NORMAL;
+	mOrder[ 2 ]		= ATTRIB_TEX_COORD;
+	mFormats[ ATTRIB_POSITION ]		= FORMAT_FLOAT;
+	mFormats[ ATTRIB_NORMAL ]		= FORMAT_FLOAT;
+	mFormats[ ATTRIB_TEX_COORD ]	= FORMAT_FLOAT;
+	update();
+}
+
+MeshHelper::VertexLayout MeshHelper::VertexLayout::interleaved( Attrib first, Attrib second, Attrib third, 
+	size_t stride, size_t alignment )
+{
+	VertexLayout layout;
+	layout.mInterleaved	= true;
+	layout.mOrder[ 0 ]	= first;
+	layout.mOrder[ 1 ]	= second;
+	layout.mOrder[ 2 ]	= third;
+	layout.mMinStride	= stride;
+	layout.mAlignment	= std::max<size_t>( alignment, 1 );
+	layout.update();
+	return layout;
+}
+
+void MeshHelper::VertexLayout::setFormat( Attrib attrib, Format format )
+{
+	bool supported = format == FORMAT_FLOAT || format == FORMAT_HALF || 
+		( format == FORMAT_UNORM16 && attrib != ATTRIB_NORMAL ) || 
+		( format == FORMAT_OCTAHEDRAL && attrib == ATTRIB_NORMAL );
+	mFormats[ attrib ] = supported ? format : FORMAT_FLOAT;
+	update();
+}
+
+bool MeshHelper::VertexLayout::isCompressed() const
+{
+	return mFormats[ ATTRIB_POSITION ] != FORMAT_FLOAT || mFormats[ ATTRIB_NORMAL ] != FORMAT_FLOAT || 
+		mFormats[ ATTRIB_TEX_COORD ] != FORMAT_FLOAT;
+}
+
+size_t MeshHelper::VertexLayout::getSize( Attrib attrib ) const
+{
+	switch ( mFormats[ attrib ] ) {
+	case FORMAT_HALF:
+	case FORMAT_UNORM16:
+		return kAttribComponents[ attrib ] * sizeof( uint16_t );
+	case FORMAT_OCTAHEDRAL:
+		return sizeof( int16_t ) * 2;
+	default:
+		return kAttribComponents[ attrib ] * sizeof( float );
+	}
+}
+
+void MeshHelper::VertexLayout::update()
+{
+	size_t offset = 0;
+	for ( size_t a = 0; a < 3; a++ ) {
+		mOffsets[ mOrder[ a ] ] = offset;
+		offset += alignUp( getSize( mOrder[ a ] ), 4 );
+	}
+	mStride = alignUp( std::max( mMinStride, offset ), mAlignment );
+}
+
+size_t MeshHelper::VertexLayout::getOffset( Attrib attrib, size_t numVertices ) const
+{
+	if ( mInterleaved ) {
+		return mOffsets[ attrib ];
+	}
+	size_t offset = 0;
+	for ( size_t a = 0; mOrder[ a ] != attrib; a++ ) {
+		offset += alignUp( getSize( mOrder[ a ] ) * numVertices, 4 );
+	}
+	return offset;
+}
+
+size_t MeshHelper::VertexLayout::getStride( Attrib attrib ) const
+{
+	return mInterleaved ? mStride : getSize( attrib );
+}
+
+size_t MeshHelper::VertexLayout::getDataSize( size_t numVertices ) const
+{
+	if ( mInterleaved ) {
+		return mStride * numVertices;
+	}
+	return getOffset( mOrder[ 2 ], numVertices ) + alignUp( getSize( mOrder[ 2 ] ) * numVertices, 4 );
+}
+
+bool MeshHelper::VertexLayout::operator==( const VertexLayout &rhs ) const
+{
+	for ( size_t a = 0; a < 3; a++ ) {
+		if ( mFormats[ a ] != rhs.mFormats[ a ] ) {
+			return false;
+		}
+	}
+	if ( mInterleaved != rhs.mInterleaved ) {
+		return false;
+	}
+	return !mInterleaved || ( mStride == rhs.mStride && mOffsets[ ATTRIB_POSITION ] == rhs.mOffsets[ ATTRIB_POSITION ] && 
+		mOffsets[ ATTRIB_NORMAL ] == rhs.mOffsets[ ATTRIB_NORMAL ] && mOffsets[ ATTRIB_TEX_COORD ] == rhs.mOffsets[ ATTRIB_TEX_COORD ] );
+}
+
+namespace
+{
+
+// Writes primitive into vertex data arranged as layout, with either 
+// 32-bit or 16-bit indices in topology
+void generateLayout( const MeshHelper::Primitive &primitive, uint32_t *indices, uint16_t *indices16, 
+	void *vertexData, const MeshHelper::VertexLayout &layout, MeshHelper::Topology topology, uint32_t numThreads )
+{
+	typedef MeshHelper::VertexLayout VertexLayout;
+
+
+	size_t numVertices	= 0;
+	size_t numIndices	= 0;
+	MeshHelper::calcSize( primitive, &numVertices, &numIndices );
+	if ( numVertices == 0 ) {
+		return;
+	}
+
+	// Compressed attributes are generated into full precision scratch 
+	// arrays first, then encoded into place
+	uint8_t *data = reinterpret_cast<uint8_t*>( vertexData );
+	vector<Vec3f> positions;
+	vector<Vec3f> normals;
+	vector<Vec2f> texCoords;
+	Output out;
+	out.mIndices	= indices;
+	out.mIndices16	= indices16;
+	out.mTopology	= topology;
+	if ( layout.getFormat( VertexLayout::ATTRIB_NORMAL ) == VertexLayout::FORMAT_FLOAT ) {
+		out.mNormals = Strided<Vec3f>( data + layout.getOffset( VertexLayout::ATTRIB_NORMAL, numVertices ), 
+			layout.getStride( VertexLayout::ATTRIB_NORMAL ) );
+	} else {
+		normals.resize( numVertices );
+		out.mNormals = Strided<Vec3f>( &normals[ 0 ] );
+	}
+	if ( layout.getFormat( VertexLayout::ATTRIB_POSITION ) == VertexLayout::FORMAT_FLOAT ) {
+		out.mPositions = Strided<Vec3f>( data + layout.getOffset( VertexLayout::ATTRIB_POSITION, numVertices ), 
+			layout.getStride( VertexLayout::ATTRIB_POSITION ) );
+	} else {
+		positions.resize( numVertices );
+		out.mPositions = Strided<Vec3f>( &positions[ 0 ] );
+	}
+	if ( layout.getFormat( VertexLayout::ATTRIB_TEX_COORD ) == VertexLayout::FORMAT_FLOAT ) {
+		out.mTexCoords = Strided<Vec2f>( data + layout.getOffset( VertexLayout::ATTRIB_TEX_COORD, numVertices ), 
+			layout.getStride( VertexLayout::ATTRIB_TEX_COORD ) );
+	} else {
+		texCoords.resize( numVertices );
+		out.mTexCoords = Strided<Vec2f>( &texCoords[ 0 ] );
+	}
+	generateOutput( primitive, numThreads, out );
+
+	if ( !layout.isCompressed() ) {
+		return;
+	}
+	EncodeJob job;
+	job.mLayout			= &layout;
+	job.mData			= data;
+	job.mNumVertices	= numVertices;
+	job.mPositions		= positions.empty() ? 0 : &positions[ 0 ];
+	job.mNormals		= normals.empty() ? 0 : &normals[ 0 ];
+	job.mTexCoords		= texCoords.empty() ? 0 : &texCoords[ 0 ];
+
+	AxisAlignedBox3f bounds	= MeshHelper::calcBounds( primitive );
+	Vec3f size				= bounds.getMax() - bounds.getMin();
+	for ( size_t c = 0; c < 3; c++ ) {
+		job.mPositionOffset[ c ]	= bounds.getMin()[ c ];
+		job.mPositionScale[ c ]		= size[ c ] > 0.0f ? 1.0f / size[ c ] : 0.0f;
+	}
+	parallelFor( numVertices, 16384, numThreads, job );
+}
+
+}
+
+void MeshHelper::generate( const Primitive &primitive, uint32_t *indices, void *vertexData, 
+	const VertexLayout &layout, uint32_t numThreads )
+{
+	generateLayout( primitive, indices, 0, vertexData, layout, MeshHelper::TOPOLOGY_TRIANGLES, numThreads );
+}
+
+// Sizes v to n elements. Resizing a big vector faults in each page of it 
+// for the first time, which costs several times more than generating the 
+// mesh that fills it. On Linux, blocks of several megabytes are advised to 
+// use transparent huge pages between reserving and resizing them, so that 
+// takes one fault per 2 MB rather than per 4 KB.
+template<typename T>
+void resizeLarge( vector<T> &v, size_t n )
+{
+#if defined( __linux__ ) && defined( MADV_HUGEPAGE )
+	static const size_t kHugePageSize = 2 << 20;
+	if ( n * sizeof( T ) >= kHugePageSize * 4 && v.capacity() < n ) {
+		v.reserve( n );
+		size_t begin	= ( reinterpret_cast<size_t>( v.data() ) + kHugePageSize - 1 ) & ~( kHugePageSize - 1 );
+		size_t end		= ( reinterpret_cast<size_t>( v.data() + n ) ) & ~( kHugePageSize - 1 );
+		madvise( reinterpret_cast<void*>( begin ), end - begin, MADV_HUGEPAGE );
+	}
+#endif
+	v.resize( n );
+}
+
+TriMesh MeshHelper::createTriMesh( const Primitive &primitive, uint32_t numThreads, vector<Vec4f> *tangents )
+{
+	size_t numVertices	= 0;
+	size_t numIndices	= 0;
+	calcSize( primitive, &numVertices, &numIndices );
+
+	TriMesh mesh;
+	if ( tangents != 0 ) {
+		resizeLarge( *tangents, numVertices );
+	}
+	if ( numVertices == 0 ) {
+		return mesh;
+	}
+	resizeLarge( mesh.getIndices(), numIndices );
+	resizeLarge( mesh.getNormals(), numVertices );
+	resizeLarge( mesh.getVertices(), numVertices );
+	resizeLarge( mesh.getTexCoords(), numVertices );
+
+	generate( primitive, numIndices > 0 ? &mesh.getIndices()[ 0 ] : 0, &mesh.getVertices()[ 0 ], 
+		&mesh.getNormals()[ 0 ], &mesh.getTexCoords()[ 0 ], numThreads, tangents != 0 ? &( *tangents )[ 0 ] : 0 );
+	return mesh;
+}
+
+MeshHelper::StagingBuffer::StagingBuffer()
+	: mNumVertices( 0 ), mNumIndices( 0 ), mIndexFormat( INDEX_UINT32 ), mTopology( TOPOLOGY_TRIANGLES )
+{
+}
+
+uint32_t MeshHelper::StagingBuffer::getIndex( size_t i ) const
+{
+	if ( mIndexFormat == INDEX_UINT16 ) {
+		uint16_t index;
+		memcpy( &index, &mIndexData[ i * sizeof( uint16_t ) ], sizeof( index ) );
+		return index;
+	}
+	uint32_t index;
+	memcpy( &index, &mIndexData[ i * sizeof( uint32_t ) ], sizeof( index ) );
+	return index;
+}
+
+const uint8_t* MeshHelper::StagingBuffer::getAttrib( VertexLayout::Attrib attrib, size_t i ) const
+{
+	return &mVertexData[ getOffset( attrib ) + getStride( attrib ) * i ];
+}
+
+Vec3f MeshHelper::StagingBuffer::getPosition( size_t i ) const
+{
+	const uint8_t *src = getAttrib( VertexLayout::ATTRIB_POSITION, i );
+	uint16_t values[ 3 ];
+	switch ( mLayout.getFormat( VertexLayout::ATTRIB_POSITION ) ) {
+	case VertexLayout::FORMAT_HALF:
+		memcpy( values, src, sizeof( values ) );
+		return Vec3f( decodeHalf( values[ 0 ] ), decodeHalf( values[ 1 ] ), decodeHalf( values[ 2 ] ) );
+	case VertexLayout::FORMAT_UNORM16:
+		{
+			memcpy( values, src, sizeof( values ) );
+			Vec3f size = mPositionBounds.getMax() - mPositionBounds.getMin();
+			return mPositionBounds.getMin() + Vec3f( size.x * decodeUnorm16( values[ 0 ] ), 
+				size.y * decodeUnorm16( values[ 1 ] ), size.z * decodeUnorm16( values[ 2 ] ) );
+		}
+	default:
+		{
+			Vec3f position;
+			memcpy( &position, src, sizeof( position ) );
+			return position;
+		}
+	}
+}
+
+Vec3f MeshHelper::StagingBuffer::getNormal( size_t i ) const
+{
+	const uint8_t *src = getAttrib( VertexLayout::ATTRIB_NORMAL, i );
+	switch ( mLayout.getFormat( VertexLayout::ATTRIB_NORMAL ) ) {
+	case VertexLayout::FORMAT_HALF:
+		{
+			uint16_t values[ 3 ];
+			memcpy( values, src, sizeof( values ) );
+			return Vec3f( decodeHalf( values[ 0 ] ), decodeHalf( values[ 1 ] ), decodeHalf( values[ 2 ] ) );
+		}
+	case VertexLayout::FORMAT_OCTAHEDRAL:
+		{
+			int16_t values[ 2 ];
+			memcpy( values, src, sizeof( values ) );
+			return decodeOctahedral( values );
+		}
+	default:
+		{
+			Vec3f normal;
+			memcpy( &normal, src, sizeof( normal ) );
+			return normal;
+		}
+	}
+}
+
+Vec2f MeshHelper::StagingBuffer::getTexCoord( size_t i ) const
+{
+	const uint8_t *src = getAttrib( VertexLayout::ATTRIB_TEX_COORD, i );
+	uint16_t values[ 2 ];
+	switch ( mLayout.getFormat( VertexLayout::ATTRIB_TEX_COORD ) ) {
+	case VertexLayout::FORMAT_HALF:
+		memcpy( values, src, sizeof( values ) );
+		return Vec2f( decodeHalf( values[ 0 ] ), decodeHalf( values[ 1 ] ) );
+	case VertexLayout::FORMAT_UNORM16:
+		memcpy( values, src, sizeof( values ) );
+		return Vec2f( decodeUnorm16( values[ 0 ] ), decodeUnorm16( values[ 1 ] ) );
+	default:
+		{
+			Vec2f texCoord;
+			memcpy( &texCoord, src, sizeof( texCoord ) );
+			return texCoord;
+		}
+	}
+}
+
+MeshHelper::StagingBuffer MeshHelper::createStagingBuffer( const Primitive &primitive, const VertexLayout &layout, 
+	IndexFormat indexFormat, Topology topology, uint32_t numThreads )
+{
+	size_t numVertices	= 0;
+	size_t numIndices	= 0;
+	calcSize( primitive, &numVertices, &numIndices, topology );
+
+	StagingBuffer buffer;
+	buffer.mLayout			= layout;
+	buffer.mTopology		= topology;
+	buffer.mPositionBounds	= calcBounds( primitive );
+	buffer.mIndexFormat		= indexFormat != INDEX_UINT32 && numVertices < 0xffff + 1 ? INDEX_UINT16 : INDEX_UINT32;
+	if ( numVertices == 0 ) {
+		return buffer;
+	}
+	buffer.mNumVertices		= numVertices;
+	buffer.mNumIndices		= numIndices;
+	buffer.mIndexData.resize( numIndices * ( buffer.mIndexFormat == INDEX_UINT16 ? sizeof( uint16_t ) : sizeof( uint32_t ) ) );
+	buffer.mVertexData.resize( layout.getDataSize( numVertices ) );
+
+	uint8_t *indices = numIndices > 0 ? &buffer.mIndexData[ 0 ] : 0;
+	if ( buffer.mIndexFormat == INDEX_UINT16 ) {
+		generateLayout( primitive, 0, reinterpret_cast<uint16_t*>( indices ), &buffer.mVertexData[ 0 ], layout, 
+			topology, numThreads );
+	} else {
+		generateLayout( primitive, reinterpret_cast<uint32_t*>( indices ), 0, &buffer.mVertexData[ 0 ], layout, 
+			topology, numThreads );
+	}
+	return buffer;
+}
+
+TriMesh MeshHelper::createTriMesh( const StagingBuffer &buffer )
+{
+	TriMesh mesh;
+	size_t numVertices = buffer.getNumVertices();
+	mesh.getNormals().resize( numVertices );
+	mesh.getVertices().resize( numVertices );
+	mesh.getTexCoords().resize( numVertices );
+	for ( size_t i = 0; i < numVertices; i++ ) {
+		mesh.getNormals()[ i ]		= buffer.getNormal( i );
+		mesh.getVertices()[ i ]		= buffer.getPosition( i );
+		mesh.getTexCoords()[ i ]	= buffer.getTexCoord( i );
+	}
+
+	vector<uint32_t> &indices = mesh.getIndices();
+	if ( buffer.getTopology() == TOPOLOGY_TRIANGLES ) {
+		indices.resize( buffer.getNumIndices() );
+		for ( size_t i = 0; i < buffer.getNumIndices(); i++ ) {
+			indices[ i ] = buffer.getIndex( i );
+		}
+		return mesh;
+	}
+
+	// Odd triangles in a strip swap their first two vertices to keep the 
+	// winding. Triangles with repeated vertices or positions are the 
+	// stitching between strips, or zero-area fillers, and are dropped.
+	const vector<Vec3f> &positions = mesh.getVertices();
+	uint32_t restart	= buffer.getRestartIndex();
+	size_t start		= 0;
+	indices.reserve( buffer.getNumIndices() * 3 );
+	for ( size_t i = 0; i < buffer.getNumIndices(); i++ ) {
+		if ( buffer.getTopology() == TOPOLOGY_STRIP_RESTART && buffer.getIndex( i ) == restart ) {
+			start = i + 1;
+			continue;
+		}
+		if ( i < start + 2 ) {
+			continue;
+		}
+		uint32_t index0 = buffer.getIndex( i - 2 );
+		uint32_t index1 = buffer.getIndex( i - 1 );
+		uint32_t index2 = buffer.getIndex( i );
+		if ( ( i - start ) % 2 != 0 ) {
+			std::swap( index0, index1 );
+		}
+		if ( positions[ index0 ] == positions[ index1 ] || positions[ index1 ] == positions[ index2 ] || 
+			positions[ index2 ] == positions[ index0 ] ) {
+			continue;
+		}
+		indices.push_back( index0 );
+		indices.push_back( index1 );
+		indices.push_back( index2 );
+	}
+	return mesh;
+}
+
+namespace
+{
+
+// Cached primitives, with the most recently used at the front of the list
+struct CacheEntry
+{
+	MeshHelper::TriMeshRef						mMesh;
+	size_t										mBytes;
+	list<MeshHelper::Primitive>::iterator		mUse;
+};
+
+// Hashes every parameter compared by Primitive::operator==()
+struct PrimitiveHash
+{
+	static void combine( size_t *seed, size_t value )
+	{
+		*seed ^= value + 0x9e3779b9 + ( *seed << 6 ) + ( *seed >> 2 );
+	}
+
+	// Adding zero turns -0.0 into 0.0, which compare equal
+	static size_t hashFloat( float value )
+	{
+		value += 0.0f;
+		uint32_t bits;
+		memcpy( &bits, &value, sizeof( bits ) );
+		return bits;
+	}
+
+	size_t operator()( const MeshHelper::Primitive &primitive ) const
+	{
+		size_t seed = (size_t)primitive.getType();
+		combine( &seed, primitive.getSegments() );
+		combine( &seed, primitive.getRings() );
+		combine( &seed, primitive.getLayers() );
+		combine( &seed, hashFloat( primitive.getTopRadius() ) );
+		combine( &seed, hashFloat( primitive.getBaseRadius() ) );
+		combine( &seed, hashFloat( primitive.getSecondRadius() ) );
+		combine( &seed, ( primitive.getCloseTop() ? 1 : 0 ) | ( primitive.getCloseBase() ? 2 : 0 ) );
+		return seed;
+	}
+};
+
+typedef unordered_map<MeshHelper::Primitive, CacheEntry, PrimitiveHash> PrimitiveCache;
+
+mutex										sCacheMutex;
+PrimitiveCache								sCache;
+list<MeshHelper::Primitive>					sCacheUse;
+size_t										sCacheBudget	= 32 * 1024 * 1024;
+size_t										sCacheSize		= 0;
+size_t										sCacheHits		= 0;
+size_t										sCacheMisses	= 0;
+
+size_t calcTriMeshBytes( const TriMesh &mesh )
+{
+	return mesh.getIndices().size() * sizeof( uint32_t ) + 
+		mesh.getNormals().size() * sizeof( Vec3f ) + 
+		mesh.getVertices().size() * sizeof( Vec3f ) + 
+		mesh.getTexCoords().size() * sizeof( Vec2f );
+}
+
+// Drops least recently used entries until the cache fits its budget. 
+// Callers hold sCacheMutex.
+void trimCache()
+{
+	while ( sCacheSize > sCacheBudget && !sCacheUse.empty() ) {
+		PrimitiveCache::iterator iter = sCache.find( sCacheUse.back() );
+		sCacheSize -= iter->second.mBytes;
+		sCache.erase( iter );
+		sCacheUse.pop_back();
+	}
+}
+
+}
+
+MeshHelper::TriMeshRef MeshHelper::getTriMesh( const Primitive &primitive )
+{
+	{
+		lock_guard<mutex> lock( sCacheMutex );
+		PrimitiveCache::iterator iter = sCache.find( primitive );
+		if ( iter != sCache.end() ) {
+			sCacheUse.splice( sCacheUse.begin(), sCacheUse, iter->second.mUse );
+			++sCacheHits;
+			return iter->second.mMesh;
+		}
+		++sCacheMisses;
+	}
+
+	// Generate outside the lock so other threads are not held up
+	TriMeshRef mesh( new TriMesh( createTriMesh( primitive ) ) );
+
+	lock_guard<mutex> lock( sCacheMutex );
+	PrimitiveCache::iterator iter = sCache.find( primitive );
+	if ( iter != sCache.end() ) {
+		return iter->second.mMesh;
+	}
+	CacheEntry &entry	= sCache[ primitive ];
+	entry.mMesh			= mesh;
+	entry.mBytes		= calcTriMeshBytes( *mesh );
+	entry.mUse			= sCacheUse.insert( sCacheUse.begin(), primitive );
+	sCacheSize			+= entry.mBytes;
+	trimCache();
+	return mesh;
+}
+
+void MeshHelper::setCacheBudget( size_t bytes )
+{
+	lock_guard<mutex> lock( sCacheMutex );
+	sCacheBudget = bytes;
+	trimCache();
+}
+
+size_t MeshHelper::getCacheBudget()
+{
+	lock_guard<mutex> lock( sCacheMutex );
+	return sCacheBudget;
+}
+
+size_t MeshHelper::getCacheSize()
+{
+	lock_guard<mutex> lock( sCacheMutex );
+	return sCacheSize;
+}
+
+size_t MeshHelper::getCacheHitCount()
+{
+	lock_guard<mutex> lock( sCacheMutex );
+	return sCacheHits;
+}
+
+size_t MeshHelper::getCacheMissCount()
+{
+	lock_guard<mutex> lock( sCacheMutex );
+	return sCacheMisses;
+}
+
+void MeshHelper::clearCache()
+{
+	lock_guard<mutex> lock( sCacheMutex );
+	sCache.clear();
+	sCacheUse.clear();
+	sCacheSize		= 0;
+	sCacheHits		= 0;
+	sCacheMisses	= 0;
+	clearCircleTables();
+}
+
+namespace
+{
+
+// Generates a range of unique primitives for createTriMeshes()
+struct BatchJob
+{
+	const vector<MeshHelper::Primitive>		*mPrimitives;
+	vector<MeshHelper::TriMeshRef>			*mMeshes;
+
+	void operator()( size_t begin, size_t end )
+	{
+		for ( size_t i = begin; i < end; ++i ) {
+			( *mMeshes )[ i ] = MeshHelper::TriMeshRef( new TriMesh( MeshHelper::createTriMesh( ( *mPrimitives )[ i ], 1 ) ) );
+		}
+	}
+};
+
+}
+
+vector<MeshHelper::TriMeshRef> MeshHelper::createTriMeshes( const vector<Primitive> &primitives, uint32_t numThreads )
+{
+	// Map each descriptor to its first occurrence
+	map<Primitive, size_t> lookup;
+	vector<Primitive> unique;
+	vector<size_t> slots( primitives.size() );
+	for ( size_t i = 0; i < primitives.size(); ++i ) {
+		map<Primitive, size_t>::iterator iter = lookup.find( primitives[ i ] );
+		if ( iter == lookup.end() ) {
+			iter = lookup.insert( make_pair( primitives[ i ], unique.size() ) ).first;
+			unique.push_back( primitives[ i ] );
+		}
+		slots[ i ] = iter->second;
+	}
+
+	vector<TriMeshRef> meshes( unique.size() );
+	BatchJob job;
+	job.mPrimitives = &unique;
+	job.mMeshes		= &meshes;
+	parallelFor( unique.size(), 1, numThreads, job );
+
+	vector<TriMeshRef> results( primitives.size() );
+	for ( size_t i = 0; i < primitives.size(); ++i ) {
+		results[ i ] = meshes[ slots[ i ] ];
+	}
+	return results;
+}
+
+MeshHelper::BatchSource::BatchSource( const Primitive &primitive, const Matrix44f &transform )
+	: mPrimitive( primitive ), mMesh( 0 ), mTransform( transform )
+{
+}
+
+MeshHelper::BatchSource::BatchSource( const TriMesh &mesh, const Matrix44f &transform )
+	: mMesh( &mesh ), mTransform( transform )
+{
+}
+
+MeshHelper::Batch::Range::Range()
+	: mIndexOffset( 0 ), mNumIndices( 0 ), mVertexOffset( 0 ), mNumVertices( 0 )
+{
+}
+
+namespace
+{
+
+// Moves count points by the affine part of column-major matrix m
+void transformPositions( const Vec3f *src, size_t count, const float *m, Vec3f *dst )
+{
+	size_t i = 0;
+	if ( useSimd() ) {
+#if defined( MESHHELPER_SSE )
+		for ( ; i + 4 <= count; i += 4 ) {
+			const Vec3f *p	= src + i;
+			__m128 x		= _mm_set_ps( p[ 3 ].x, p[ 2 ].x, p[ 1 ].x, p[ 0 ].x );
+			__m128 y		= _mm_set_ps( p[ 3 ].y, p[ 2 ].y, p[ 1 ].y, p[ 0 ].y );
+			__m128 z		= _mm_set_ps( p[ 3 ].z, p[ 2 ].z, p[ 1 ].z, p[ 0 ].z );
+			__m128 r[ 3 ];
+			for ( size_t k = 0; k < 3; k++ ) {
+				r[ k ] = _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( m[ k ] ), x ), 
+					_mm_mul_ps( _mm_set1_ps( m[ k + 4 ] ), y ) ), _mm_mul_ps( _mm_set1_ps( m[ k + 8 ] ), z ) ), 
+					_mm_set1_ps( m[ k + 12 ] ) );
+			}
+			storeVec3x4( &dst[ i ].x, r[ 0 ], r[ 1 ], r[ 2 ] );
+		}
+#elif defined( MESHHELPER_NEON )
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4x3_t p = vld3q_f32( &src[ i ].x );
+			float32x4x3_t r;
+			for ( size_t k = 0; k < 3; k++ ) {
+				r.val[ k ] = vaddq_f32( vaddq_f32( vaddq_f32( vmulq_n_f32( p.val[ 0 ], m[ k ] ), 
+					vmulq_n_f32( p.val[ 1 ], m[ k + 4 ] ) ), vmulq_n_f32( p.val[ 2 ], m[ k + 8 ] ) ), 
+					vdupq_n_f32( m[ k + 12 ] ) );
+			}
+			vst3q_f32( &dst[ i ].x, r );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		const Vec3f &p = src[ i ];
+		dst[ i ] = Vec3f( m[ 0 ] * p.x + m[ 4 ] * p.y + m[ 8 ] * p.z + m[ 12 ], 
+			m[ 1 ] * p.x + m[ 5 ] * p.y + m[ 9 ] * p.z + m[ 13 ], 
+			m[ 2 ] * p.x + m[ 6 ] * p.y + m[ 10 ] * p.z + m[ 14 ] );
+	}
+}
+
+// Scales v to unit length, leaving it alone when it has none
+inline Vec3f normalizeOrKeep( const Vec3f &v )
+{
+	float length = math<float>::sqrt( v.x * v.x + v.y * v.y + v.z * v.z );
+	if ( length <= 0.0f ) {
+		return v;
+	}
+	float scale = 1.0f / length;
+	return Vec3f( v.x * scale, v.y * scale, v.z * scale );
+}
+
+#if defined( MESHHELPER_SSE )
+
+// Four vectors in xxxx, yyyy, zzzz form normalized as by normalizeOrKeep(), 
+// then stored as twelve packed floats
+inline void storeNormalized4( float *dst, __m128 x, __m128 y, __m128 z )
+{
+	__m128 length	= _mm_sqrt_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( x, x ), _mm_mul_ps( y, y ) ), _mm_mul_ps( z, z ) ) );
+	__m128 valid	= _mm_cmpgt_ps( length, _mm_setzero_ps() );
+	__m128 scale	= select( valid, _mm_div_ps( _mm_set1_ps( 1.0f ), length ), _mm_set1_ps( 1.0f ) );
+	storeVec3x4( dst, _mm_mul_ps( x, scale ), _mm_mul_ps( y, scale ), _mm_mul_ps( z, scale ) );
+}
+
+#elif defined( MESHHELPER_NEON )
+
+// Four vectors normalized as by normalizeOrKeep(), then stored as twelve packed floats. 
+// NEON has no exact vector square root or divide on ARMv7, so the scales are per lane.
+inline void storeNormalized4( float *dst, float32x4x3_t v )
+{
+	float lengths[ 4 ];
+	vst1q_f32( lengths, vaddq_f32( vaddq_f32( vmulq_f32( v.val[ 0 ], v.val[ 0 ] ), 
+		vmulq_f32( v.val[ 1 ], v.val[ 1 ] ) ), vmulq_f32( v.val[ 2 ], v.val[ 2 ] ) ) );
+	for ( size_t e = 0; e < 4; e++ ) {
+		float length	= math<float>::sqrt( lengths[ e ] );
+		lengths[ e ]	= length > 0.0f ? 1.0f / length : 1.0f;
+	}
+	float32x4_t scale = vld1q_f32( lengths );
+	for ( size_t k = 0; k < 3; k++ ) {
+		v.val[ k ] = vmulq_f32( v.val[ k ], scale );
+	}
+	vst3q_f32( dst, v );
+}
+
+#endif
+
+// Moves count normals by column-major 3x3 matrix m and normalizes them
+void transformNormals( const Vec3f *src, size_t count, const float *m, Vec3f *dst )
+{
+	size_t i = 0;
+	if ( useSimd() ) {
+#if defined( MESHHELPER_SSE )
+		for ( ; i + 4 <= count; i += 4 ) {
+			const Vec3f *n	= src + i;
+			__m128 x		= _mm_set_ps( n[ 3 ].x, n[ 2 ].x, n[ 1 ].x, n[ 0 ].x );
+			__m128 y		= _mm_set_ps( n[ 3 ].y, n[ 2 ].y, n[ 1 ].y, n[ 0 ].y );
+			__m128 z		= _mm_set_ps( n[ 3 ].z, n[ 2 ].z, n[ 1 ].z, n[ 0 ].z );
+			__m128 r[ 3 ];
+			for ( size_t k = 0; k < 3; k++ ) {
+				r[ k ] = _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( m[ k ] ), x ), 
+					_mm_mul_ps( _mm_set1_ps( m[ k + 3 ] ), y ) ), _mm_mul_ps( _mm_set1_ps( m[ k + 6 ] ), z ) );
+			}
+			storeNormalized4( &dst[ i ].x, r[ 0 ], r[ 1 ], r[ 2 ] );
+		}
+#elif defined( MESHHELPER_NEON )
+		for ( ; i + 4 <= count; i += 4 ) {
+			float32x4x3_t n = vld3q_f32( &src[ i ].x );
+			float32x4x3_t r;
+			for ( size_t k = 0; k < 3; k++ ) {
+				r.val[ k ] = vaddq_f32( vaddq_f32( vmulq_n_f32( n.val[ 0 ], m[ k ] ), 
+					vmulq_n_f32( n.val[ 1 ], m[ k + 3 ] ) ), vmulq_n_f32( n.val[ 2 ], m[ k + 6 ] ) );
+			}
+			storeNormalized4( &dst[ i ].x, r );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		const Vec3f &n = src[ i ];
+		dst[ i ] = normalizeOrKeep( Vec3f( m[ 0 ] * n.x + m[ 3 ] * n.y + m[ 6 ] * n.z, 
+			m[ 1 ] * n.x + m[ 4 ] * n.y + m[ 7 ] * n.z, 
+			m[ 2 ] * n.x + m[ 5 ] * n.y + m[ 8 ] * n.z ) );
+	}
+}
+
+// Merges a range of sources into their ranges of a batch for createBatch()
+struct MergeJob
+{
+	const vector<MeshHelper::BatchSource>		*mSources;
+	const vector<const TriMesh *>				*mMeshes;
+	const vector<MeshHelper::Batch::Range>		*mRanges;
+	uint32_t									*mIndices;
+	Vec3f										*mPositions;
+	Vec3f										*mNormals;
+	Vec2f										*mTexCoords;
+
+	void operator()( size_t begin, size_t end )
+	{
+		for ( size_t i = begin; i < end; ++i ) {
+			const TriMesh &mesh					= *( *mMeshes )[ i ];
+			const MeshHelper::Batch::Range &range	= ( *mRanges )[ i ];
+			const float *m						= ( *mSources )[ i ].getTransform().m;
+			size_t numVertices					= range.getNumVertices();
+			if ( numVertices == 0 ) {
+				continue;
+			}
+
+			// The normal matrix is the cofactor matrix of the upper 3x3, which is 
+			// the inverse transpose scaled by the determinant. Its sign is taken 
+			// out, and normalizing takes care of the rest.
+			Vec3f c0( m[ 0 ], m[ 1 ], m[ 2 ] );
+			Vec3f c1( m[ 4 ], m[ 5 ], m[ 6 ] );
+			Vec3f c2( m[ 8 ], m[ 9 ], m[ 10 ] );
+			Vec3f n0	= c1.cross( c2 );
+			Vec3f n1	= c2.cross( c0 );
+			Vec3f n2	= c0.cross( c1 );
+			bool mirror	= c0.dot( n0 ) < 0.0f;
+			float sign	= mirror ? -1.0f : 1.0f;
+			float normalMatrix[ 9 ] = { n0.x * sign, n0.y * sign, n0.z * sign, n1.x * sign, n1.y * sign, n1.z * sign, 
+				n2.x * sign, n2.y * sign, n2.z * sign };
+
+			size_t v = range.getVertexOffset();
+			transformPositions( &mesh.getVertices()[ 0 ], numVertices, m, mPositions + v );
+			if ( mNormals != 0 ) {
+				transformNormals( &mesh.getNormals()[ 0 ], numVertices, normalMatrix, mNormals + v );
+			}
+			if ( mTexCoords != 0 ) {
+				memcpy( mTexCoords + v, &mesh.getTexCoords()[ 0 ], numVertices * sizeof( Vec2f ) );
+			}
+
+			// Mirroring turns triangles inside out, so their 
+			// last two corners are swapped to turn them back
+			const uint32_t *src	= mesh.getIndices().empty() ? 0 : &mesh.getIndices()[ 0 ];
+			uint32_t *dst		= mIndices + range.getIndexOffset();
+			uint32_t offset		= (uint32_t)v;
+			for ( size_t t = 0; t + 3 <= range.getNumIndices(); t += 3 ) {
+				dst[ t ]		= src[ t ] + offset;
+				dst[ t + 1 ]	= src[ mirror ? t + 2 : t + 1 ] + offset;
+				dst[ t + 2 ]	= src[ mirror ? t + 1 : t + 2 ] + offset;
+			}
+		}
+	}
+};
+
+}
+
+MeshHelper::Batch MeshHelper::createBatch( const vector<BatchSource> &sources, uint32_t numThreads )
+{
+	// Primitives are generated first, each distinct one once
+	vector<Primitive> primitives;
+	for ( vector<BatchSource>::const_iterator iter = sources.begin(); iter != sources.end(); ++iter ) {
+		if ( iter->getTriMesh() == 0 ) {
+			primitives.push_back( iter->getPrimitive() );
+		}
+	}
+	vector<TriMeshRef> generated = createTriMeshes( primitives, numThreads );
+
+	// Lay the sources out one after another
+	Batch batch;
+	batch.mRanges.resize( sources.size() );
+	vector<const TriMesh *> meshes( sources.size() );
+	size_t numIndices	= 0;
+	size_t numVertices	= 0;
+	bool normals		= true;
+	bool texCoords		= true;
+	for ( size_t i = 0, p = 0; i < sources.size(); ++i ) {
+		const TriMesh *mesh = sources[ i ].getTriMesh() != 0 ? sources[ i ].getTriMesh() : generated[ p++ ].get();
+		meshes[ i ] = mesh;
+
+		Batch::Range &range	= batch.mRanges[ i ];
+		range.mIndexOffset	= numIndices;
+		range.mNumIndices	= mesh->getNumTriangles() * 3;
+		range.mVertexOffset	= numVertices;
+		range.mNumVertices	= mesh->getNumVertices();
+		numIndices			+= range.mNumIndices;
+		numVertices			+= range.mNumVertices;
+		normals				= normals && mesh->getNormals().size() == mesh->getNumVertices();
+		texCoords			= texCoords && mesh->getTexCoords().size() == mesh->getNumVertices();
+	}
+
+	TriMesh &mesh = batch.mMesh;
+	mesh.getIndices().resize( numIndices );
+	mesh.getVertices().resize( numVertices );
+	if ( normals ) {
+		mesh.getNormals().resize( numVertices );
+	}
+	if ( texCoords ) {
+		mesh.getTexCoords().resize( numVertices );
+	}
+	if ( numVertices == 0 ) {
+		return batch;
+	}
+
+	MergeJob job;
+	job.mSources	= &sources;
+	job.mMeshes		= &meshes;
+	job.mRanges		= &batch.mRanges;
+	job.mIndices	= numIndices > 0 ? &mesh.getIndices()[ 0 ] : 0;
+	job.mPositions	= &mesh.getVertices()[ 0 ];
+	job.mNormals	= normals ? &mesh.getNormals()[ 0 ] : 0;
+	job.mTexCoords	= texCoords ? &mesh.getTexCoords()[ 0 ] : 0;
+
+	numThreads		= getNumThreads( numThreads );
+	size_t grain	= std::max<size_t>( sources.size() / ( numThreads * 8 ), 1 );
+	parallelFor( sources.size(), grain, numThreads, job );
+	return batch;
+}
+
+MeshHelper::LodChain::Level::Level()
+	: mIndexOffset( 0 ), mNumIndices( 0 ), mError( 0.0f )
+{
+}
+
+namespace
+{
+
+// Returns the next level of detail below primitive in coarser, or 
+// false when halving it would leave a part of a segment or ring
+bool halveDetail( const MeshHelper::Primitive &primitive, MeshHelper::Primitive *coarser )
+{
+	uint32_t segments	= primitive.getSegments();
+	uint32_t rings		= primitive.getRings();
+	uint32_t layers		= primitive.getLayers();
+	switch ( primitive.getType() ) {
+	case MeshHelper::PRIMITIVE_CIRCLE:
+		if ( segments % 2 == 0 && segments / 2 >= 3 ) {
+			*coarser = MeshHelper::Primitive::circle( segments / 2 );
+			return true;
+		}
+		break;
+	case MeshHelper::PRIMITIVE_CONE:
+		// Layers are halved along with the segments when they can be
+		if ( segments % 2 == 0 && segments / 2 >= 3 ) {
+			*coarser = MeshHelper::Primitive::cone( segments / 2, primitive.getCloseBase(), 
+				layers % 2 == 0 ? layers / 2 : layers );
+			return true;
+		}
+		break;
+	case MeshHelper::PRIMITIVE_CUBE:
+		if ( layers % 2 == 0 ) {
+			*coarser = MeshHelper::Primitive::cube( layers / 2 );
+			return true;
+		}
+		break;
+	case MeshHelper::PRIMITIVE_CYLINDER:
+		if ( segments % 2 == 0 && segments / 2 >= 3 ) {
+			*coarser = MeshHelper::Primitive::cylinder( segments / 2, primitive.getTopRadius(), 
+				primitive.getBaseRadius(), primitive.getCloseTop(), primitive.getCloseBase(), 
+				layers % 2 == 0 ? layers / 2 : layers );
+			return true;
+		}
+		break;
+	case MeshHelper::PRIMITIVE_RING:
+		if ( segments % 2 == 0 && segments / 2 >= 3 ) {
+			*coarser = MeshHelper::Primitive::ring( segments / 2, primitive.getSecondRadius() );
+			return true;
+		}
+		break;
+	case MeshHelper::PRIMITIVE_SPHERE:
+		if ( segments % 2 == 0 && segments / 2 >= 3 && rings % 2 == 0 && rings / 2 >= 2 ) {
+			*coarser = MeshHelper::Primitive::sphere( segments / 2, rings / 2 );
+			return true;
+		}
+		break;
+	case MeshHelper::PRIMITIVE_PLANE:
+		// Planes count vertices rather than segments
+		if ( segments > 2 && segments % 2 == 1 && rings > 2 && rings % 2 == 1 ) {
+			*coarser = MeshHelper::Primitive::plane( segments / 2 + 1, rings / 2 + 1 );
+			return true;
+		}
+		break;
+	case MeshHelper::PRIMITIVE_ICOSPHERE:
+		// Each subdivision's vertices follow the coarser one's, so removing 
+		// one leaves the vertices at the front, where lodVertex() expects them
+		if ( segments > 0 ) {
+			*coarser = MeshHelper::Primitive::icosphere( segments - 1 );
+			return true;
+		}
+		break;
+	case MeshHelper::PRIMITIVE_TORUS:
+		if ( segments % 2 == 0 && segments / 2 >= 3 && rings % 2 == 0 && rings / 2 >= 3 ) {
+			*coarser = MeshHelper::Primitive::torus( segments / 2, rings / 2, primitive.getTopRadius(), 
+				primitive.getSecondRadius() );
+			return true;
+		}
+		break;
+	default:
+		break;
+	}
+	return false;
+}
+
+// Largest distance between the facets of primitive and the surface it approximates. 
+// A chord spanning angle a of a circle of radius r is r * ( 1 - cos( a / 2 ) ) from it 
+// at most, and the middle of a sphere's quad is off by both its angles.
+float calcLodError( const MeshHelper::Primitive &primitive )
+{
+	float halfSegment = (float)M_PI / (float)primitive.getSegments();
+	switch ( primitive.getType() ) {
+	case MeshHelper::PRIMITIVE_CIRCLE:
+	case MeshHelper::PRIMITIVE_CONE:
+		return 1.0f - math<float>::cos( halfSegment );
+	case MeshHelper::PRIMITIVE_CYLINDER:
+		return math<float>::max( math<float>::abs( primitive.getTopRadius() ), 
+			math<float>::abs( primitive.getBaseRadius() ) ) * ( 1.0f - math<float>::cos( halfSegment ) );
+	case MeshHelper::PRIMITIVE_RING:
+		return math<float>::max( 1.0f, math<float>::abs( primitive.getSecondRadius() ) ) * 
+			( 1.0f - math<float>::cos( halfSegment ) );
+	case MeshHelper::PRIMITIVE_SPHERE:
+		return 1.0f - math<float>::cos( halfSegment ) * 
+			math<float>::cos( (float)M_PI * 0.5f / (float)primitive.getRings() );
+	case MeshHelper::PRIMITIVE_ICOSPHERE:
+		{
+			// Subdivided faces vary in size, so each is measured 
+			// where its plane comes closest to the center
+			TriMesh mesh	= MeshHelper::createTriMesh( primitive );
+			float error		= 0.0f;
+			for ( size_t t = 0; t < mesh.getNumTriangles(); t++ ) {
+				Vec3f a, b, c;
+				mesh.getTriangleVertices( t, &a, &b, &c );
+				error = math<float>::max( error, 1.0f - ( b - a ).cross( c - a ).normalized().dot( a ) );
+			}
+			return error;
+		}
+	case MeshHelper::PRIMITIVE_TORUS:
+		{
+			// At most the chord errors of the outer equator and the tube added together
+			float minorRadius = math<float>::abs( primitive.getSecondRadius() );
+			return ( math<float>::abs( primitive.getTopRadius() ) + minorRadius ) * ( 1.0f - math<float>::cos( halfSegment ) ) + 
+				minorRadius * ( 1.0f - math<float>::cos( (float)M_PI / (float)primitive.getRings() ) );
+		}
+	default:
+		return 0.0f;
+	}
+}
+
+// Index of a cap vertex in a cap with factor times as many segments, 
+// where zero is the center
+inline uint32_t lodCapVertex( uint32_t v, uint32_t factor )
+{
+	return v == 0 ? 0 : 1 + ( v - 1 ) * factor;
+}
+
+// Maps vertex v of coarse to the vertex at the same place in fine, which has factor 
+// times the segments and rings, and the same or twice the layers, or factor times 
+// for cubes. Pole and apex vertices sit in the middle of their segment, which is 
+// between two of the finer ones, so the one after it is used.
+uint32_t lodVertex( const MeshHelper::Primitive &fine, const MeshHelper::Primitive &coarse, uint32_t factor, uint32_t v )
+{
+	uint32_t segments		= coarse.getSegments();
+	uint32_t fineSegments	= fine.getSegments();
+	switch ( coarse.getType() ) {
+	case MeshHelper::PRIMITIVE_CIRCLE:
+		return lodCapVertex( v, factor );
+	case MeshHelper::PRIMITIVE_CONE:
+		{
+			// Side rows are counted from the first ring below the apex
+			uint32_t rows		= coarse.getLayers();
+			uint32_t fineRows	= fine.getLayers();
+			if ( v < segments ) {
+				return v * factor + factor / 2;
+			}
+			v -= segments;
+			if ( v < rows * ( segments + 1 ) ) {
+				uint32_t y = ( v / ( segments + 1 ) + 1 ) * ( fineRows / rows ) - 1;
+				return fineSegments + y * ( fineSegments + 1 ) + ( v % ( segments + 1 ) ) * factor;
+			}
+			return fineSegments + fineRows * ( fineSegments + 1 ) + lodCapVertex( v - rows * ( segments + 1 ), factor );
+		}
+	case MeshHelper::PRIMITIVE_CUBE:
+		{
+			uint32_t columns		= coarse.getLayers() + 1;
+			uint32_t fineColumns	= fine.getLayers() + 1;
+			uint32_t f				= v / ( columns * columns );
+			v %= columns * columns;
+			return f * fineColumns * fineColumns + ( v / columns ) * factor * fineColumns + ( v % columns ) * factor;
+		}
+	case MeshHelper::PRIMITIVE_CYLINDER:
+		{
+			uint32_t rows		= coarse.getLayers() + 1;
+			uint32_t fineRows	= fine.getLayers() + 1;
+			uint32_t cap		= coarse.getCloseTop() ? segments + 1 : 0;
+			uint32_t fineCap	= coarse.getCloseTop() ? fineSegments + 1 : 0;
+			if ( v < cap ) {
+				return lodCapVertex( v, factor );
+			}
+			v -= cap;
+			if ( v < ( segments + 1 ) * rows ) {
+				uint32_t y = ( v / ( segments + 1 ) ) * ( fine.getLayers() / coarse.getLayers() );
+				return fineCap + y * ( fineSegments + 1 ) + ( v % ( segments + 1 ) ) * factor;
+			}
+			return fineCap + ( fineSegments + 1 ) * fineRows + lodCapVertex( v - ( segments + 1 ) * rows, factor );
+		}
+	case MeshHelper::PRIMITIVE_RING:
+		return v < segments ? v * factor : fineSegments + ( v - segments ) * factor;
+	case MeshHelper::PRIMITIVE_SPHERE:
+		{
+			uint32_t p = 0;
+			uint32_t t = v;
+			if ( v >= segments ) {
+				p = 1 + ( v - segments ) / ( segments + 1 );
+				t = ( v - segments ) % ( segments + 1 );
+			}
+			bool pole = p == 0 || p == coarse.getRings();
+			return sphereIndex( p * factor, t * factor + ( pole ? factor / 2 : 0 ), fineSegments );
+		}
+	case MeshHelper::PRIMITIVE_PLANE:
+		return ( v / segments ) * factor * fineSegments + ( v % segments ) * factor;
+	case MeshHelper::PRIMITIVE_TORUS:
+		return ( v / ( segments + 1 ) ) * factor * ( fineSegments + 1 ) + ( v % ( segments + 1 ) ) * factor;
+	default:
+		return v;
+	}
+}
+
+}
+
+MeshHelper::LodChain MeshHelper::createLodChain( const Primitive &primitive, uint32_t numLevels, uint32_t numThreads )
+{
+	LodChain chain;
+	chain.mMesh = createTriMesh( primitive, numThreads );
+
+	LodChain::Level level;
+	level.mPrimitive	= primitive;
+	level.mNumIndices	= chain.mMesh.getNumIndices();
+	level.mError		= calcLodError( primitive );
+	chain.mLevels.push_back( level );
+
+	// Coarser levels are generated on their own, then their 
+	// indices are moved onto the full detail vertices
+	vector<uint32_t> &indices = chain.mMesh.getIndices();
+	uint32_t factor = 1;
+	Primitive coarse;
+	while ( ( numLevels == 0 || chain.mLevels.size() < numLevels ) && halveDetail( level.mPrimitive, &coarse ) ) {
+		factor *= 2;
+		size_t numVertices	= 0;
+		size_t numIndices	= 0;
+		calcSize( coarse, &numVertices, &numIndices );
+
+		level.mPrimitive	= coarse;
+		level.mIndexOffset	= indices.size();
+		level.mNumIndices	= numIndices;
+		level.mError		= calcLodError( coarse );
+		indices.resize( level.mIndexOffset + numIndices );
+		uint32_t *levelIndices = &indices[ level.mIndexOffset ];
+		generate( coarse, levelIndices, 0, 0, 0, numThreads );
+		for ( size_t i = 0; i < numIndices; ++i ) {
+			levelIndices[ i ] = lodVertex( primitive, coarse, factor, levelIndices[ i ] );
+		}
+		chain.mLevels.push_back( level );
+	}
+	return chain;
+}
+
+TriMesh MeshHelper::createCircleTriMesh( uint32_t segments, vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::circle( segments ), 0, tangents );
+}
+
+TriMesh MeshHelper::createConeTriMesh( uint32_t segments, bool closeBase, uint32_t layers, uint32_t numThreads, 
+	vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::cone( segments, closeBase, layers ), numThreads, tangents );
+}
+
+TriMesh MeshHelper::createCubeTriMesh( uint32_t subdivisions, uint32_t numThreads, vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::cube( subdivisions ), numThreads, tangents );
+}
+
+TriMesh MeshHelper::createCylinderTriMesh( uint32_t segments, float topRadius, float baseRadius, bool closeTop, bool closeBase, 
+	uint32_t layers, uint32_t numThreads, vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::cylinder( segments, topRadius, baseRadius, closeTop, closeBase, layers ), numThreads, 
+		tangents );
+}
+
+TriMesh MeshHelper::createRingTriMesh( uint32_t segments, float secondRadius, vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::ring( segments, secondRadius ), 0, tangents );
+}
+
+TriMesh MeshHelper::createSphereTriMesh( uint32_t segments, uint32_t rings, vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::sphere( segments, rings ), 0, tangents );
+}
+
+TriMesh MeshHelper::createPlaneTriMesh( uint32_t hSegments, uint32_t vSegments, uint32_t numThreads, vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::plane( hSegments, vSegments ), numThreads, tangents );
+}
+
+TriMesh MeshHelper::createIcosphereTriMesh( uint32_t subdivisions, vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::icosphere( subdivisions ), 0, tangents );
+}
+
+TriMesh MeshHelper::createTorusTriMesh( uint32_t majorSegments, uint32_t minorSegments, float majorRadius, 
+	float minorRadius, uint32_t numThreads, vector<Vec4f> *tangents )
+{
+	return createTriMesh( Primitive::torus( majorSegments, minorSegments, majorRadius, minorRadius ), numThreads, tangents );
+}
+
+float MeshHelper::calcAcmr( const vector<uint32_t> &indices, size_t numVertices, uint32_t cacheSize )
+{
+	size_t numTriangles = indices.size() / 3;
+	if ( numTriangles == 0 ) {
+		return 0.0f;
+	}
+
+	// A vertex is cached while fewer than cacheSize misses have 
+	// happened since it went in. Zero means it never did.
+	vector<size_t> entered( numVertices, 0 );
+	size_t misses = 0;
+	for ( size_t i = 0; i < numTriangles * 3; ++i ) {
+		uint32_t v = indices[ i ];
+		if ( entered[ v ] == 0 || misses - entered[ v ] >= cacheSize ) {
+			entered[ v ] = ++misses;
+		}
+	}
+	return (float)misses / (float)numTriangles;
+}
+
+namespace
+{
+
+// Triangles using each vertex, stored as runs in one array
+struct VertexAdjacency
+{
+	vector<uint32_t>	mOffsets;
+	vector<uint32_t>	mTriangles;
+
+	VertexAdjacency( const vector<uint32_t> &indices, size_t numVertices )
+		: mOffsets( numVertices + 1, 0 ), mTriangles( indices.size() - indices.size() % 3 )
+	{
+		for ( size_t i = 0; i < mTriangles.size(); ++i ) {
+			++mOffsets[ indices[ i ] + 1 ];
+		}
+		for ( size_t v = 0; v < numVertices; ++v ) {
+			mOffsets[ v + 1 ] += mOffsets[ v ];
+		}
+		vector<uint32_t> fill( mOffsets.begin(), mOffsets.end() - 1 );
+		for ( size_t i = 0; i < mTriangles.size(); ++i ) {
+			mTriangles[ fill[ indices[ i ] ]++ ] = (uint32_t)( i / 3 );
+		}
+	}
+
+	inline uint32_t	begin( size_t v ) const { return mOffsets[ v ]; }
+	inline uint32_t	end( size_t v ) const { return mOffsets[ v + 1 ]; }
+};
+
+}
+
+float MeshHelper::optimizeVertexCache( vector<uint32_t> &indices, size_t numVertices, uint32_t cacheSize )
+{
+	size_t numTriangles = indices.size() / 3;
+	if ( numTriangles == 0 || numVertices == 0 ) {
+		return 0.0f;
+	}
+
+	// Tipsify, from "Fast Triangle Reordering for Vertex Locality and Reduced 
+	// Overdraw" by Sander, Nehab and Barczak. Triangles are emitted in fans 
+	// around a vertex. The next fan is the most recently cached neighbor that 
+	// will still be cached once its remaining triangles are emitted, falling 
+	// back on recently used vertices, then on the next unfinished vertex.
+	VertexAdjacency adjacency( indices, numVertices );
+	vector<uint32_t> live( numVertices );
+	for ( size_t v = 0; v < numVertices; ++v ) {
+		live[ v ] = adjacency.end( v ) - adjacency.begin( v );
+	}
+	vector<size_t> cacheTime( numVertices, 0 );
+	vector<bool> emitted( numTriangles, false );
+	vector<uint32_t> deadEnd;
+	vector<uint32_t> candidates;
+	vector<uint32_t> output;
+	deadEnd.reserve( numTriangles * 3 );
+	output.reserve( numTriangles * 3 );
+
+	size_t time		= cacheSize + 1;
+	size_t cursor	= 0;
+	size_t fan		= 0;
+	while ( fan < numVertices ) {
+		candidates.clear();
+		for ( uint32_t a = adjacency.begin( fan ); a < adjacency.end( fan ); ++a ) {
+			uint32_t t = adjacency.mTriangles[ a ];
+			if ( emitted[ t ] ) {
+				continue;
+			}
+			for ( size_t c = 0; c < 3; ++c ) {
+				uint32_t v = indices[ t * 3 + c ];
+				output.push_back( v );
+				deadEnd.push_back( v );
+				candidates.push_back( v );
+				--live[ v ];
+				if ( time - cacheTime[ v ] > cacheSize ) {
+					cacheTime[ v ] = time++;
+				}
+			}
+			emitted[ t ] = true;
+		}
+
+		size_t best		= numVertices;
+		size_t priority	= 0;
+		for ( size_t i = 0; i < candidates.size(); ++i ) {
+			uint32_t v = candidates[ i ];
+			if ( live[ v ] == 0 ) {
+				continue;
+			}
+			size_t age		= time - cacheTime[ v ];
+			size_t score	= age + 2 * live[ v ] <= cacheSize ? age + 1 : 1;
+			if ( score > priority ) {
+				priority	= score;
+				best		= v;
+			}
+		}
+		while ( best == numVertices && !deadEnd.empty() ) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if ( live[ v ] > 0 ) {
+				best = v;
+			}
+		}
+		while ( best == numVertices && cursor < numVertices ) {
+			if ( live[ cursor ] > 0 ) {
+				best = cursor;
+			}
+			++cursor;
+		}
+		fan = best;
+	}
+
+	std::copy( output.begin(), output.end(), indices.begin() );
+	return calcAcmr( indices, numVertices, cacheSize );
+}
+
+float MeshHelper::optimizeVertexCache( TriMesh &mesh, uint32_t cacheSize )
+{
+	return optimizeVertexCache( mesh.getIndices(), mesh.getNumVertices(), cacheSize );
+}
+
+namespace
+{
+
+const uint32_t kUnusedVertex = 0xffffffff;
+
+// Numbers vertices in the order indices first use them and rewrites 
+// indices to match. Returns the number of vertices used.
+size_t remapIndices( vector<uint32_t> &indices, size_t numVertices, vector<uint32_t> *remap )
+{
+	remap->assign( numVertices, kUnusedVertex );
+	uint32_t count = 0;
+	for ( size_t i = 0; i < indices.size(); ++i ) {
+		uint32_t &index = ( *remap )[ indices[ i ] ];
+		if ( index == kUnusedVertex ) {
+			index = count++;
 		}
+		indices[ i ] = index;
 	}
-	if ( positions.size() > 0 ) {
-		mesh.appendVertices( &positions[ 0 ], positions.size() );
+	return count;
+}
+
+// Moves each used value to its remapped position, leaving 
+// vectors that don't hold a value per vertex alone
+template<typename T>
+void remapVertices( vector<T> &values, const vector<uint32_t> &remap, size_t count )
+{
+	if ( values.size() != remap.size() ) {
+		return;
 	}
-	if ( texCoords.size() > 0 ) {
-		for ( vector<Vec2f>::const_iterator iter = texCoords.begin(); iter != texCoords.end(); ++iter ) {
-			mesh.appendTexCoord( *iter );
+	vector<T> remapped( count );
+	for ( size_t v = 0; v < remap.size(); ++v ) {
+		if ( remap[ v ] != kUnusedVertex ) {
+			remapped[ remap[ v ] ] = values[ v ];
 		}
 	}
-	return mesh;
+	values.swap( remapped );
+}
+
 }
 
-TriMesh MeshHelper::createCircleTriMesh( uint32_t segments )
+size_t MeshHelper::optimizeVertexFetch( vector<uint32_t> &indices, vector<Vec3f> &positions, 
+	vector<Vec3f> &normals, vector<Vec2f> &texCoords )
 {
-	vector<uint32_t> indices;
-	vector<Vec3f> normals;
-	vector<Vec3f> positions;
-	vector<Vec2f> texCoords;
+	vector<uint32_t> remap;
+	size_t count = remapIndices( indices, positions.size(), &remap );
+	remapVertices( positions, remap, count );
+	remapVertices( normals, remap, count );
+	remapVertices( texCoords, remap, count );
+	return count;
+}
 
-	Vec3f norm0( 0.0f, 0.0f, 1.0f );
+size_t MeshHelper::optimizeVertexFetch( TriMesh &mesh )
+{
+	vector<uint32_t> remap;
+	size_t count = remapIndices( mesh.getIndices(), mesh.getNumVertices(), &remap );
+	remapVertices( mesh.getVertices(), remap, count );
+	remapVertices( mesh.getNormals(), remap, count );
+	remapVertices( mesh.getTexCoords(), remap, count );
+	remapVertices( mesh.getColorsRGB(), remap, count );
+	remapVertices( mesh.getColorsRGBA(), remap, count );
+	return count;
+}
 
-	Vec3f vert1		= Vec3f::zero();
-	Vec2f texCoord1 = Vec2f::one() * 0.5f;
+namespace
+{
 
-	float delta = ( (float)M_PI * 2.0f ) / (float)segments;
-	float theta = delta;
-	for ( uint32_t i = 0; i < segments; ++i, theta += delta ) {
+// Spatial hash of vertex positions for weldVertices(). Vertices are bucketed by 
+// the hash of the cell they fall in, in index order, so each bucket lists its 
+// vertices from first to last. Different cells may share a bucket.
+struct WeldHash
+{
+	// Attributes are copied in with their vertex, so scanning 
+	// a bucket doesn't jump around the attribute arrays
+	struct Entry
+	{
+		Vec3f		mPosition;
+		Vec3f		mNormal;
+		Vec2f		mTexCoord;
+		uint32_t	mVertex;
+	};
 
-		Vec3f vert0( math<float>::cos( theta ), math<float>::sin( theta ), 0.0f );
-		Vec3f vert2 = Vec3f::zero();
-		if ( i >= segments - 1 ) {
-			vert2.x = math<float>::cos( delta );
-			vert2.y = math<float>::sin( delta ); 
-		} else {
-			vert2.x = math<float>::cos( theta + delta );
-			vert2.y = math<float>::sin( theta + delta );
+	const Vec3f			*mPositions;
+	double				mScale;
+	vector<uint32_t>	mKeys;
+	vector<uint32_t>	mOffsets;
+	vector<Entry>		mEntries;
+	uint32_t			mMask;
+
+	/* Cells are eight times epsilon wide, so most positions are further than 
+	   epsilon from every face of their cell. On each axis, n holds the neighbor 
+	   within epsilon of the position, or its own cell when there is none. Cells 
+	   are exact positions when mScale is zero. */
+	inline void cell( const Vec3f &position, int64_t *c, int64_t *n = 0 ) const
+	{
+		for ( size_t i = 0; i < 3; ++i ) {
+			if ( mScale > 0.0 ) {
+				double value	= (double)position[ i ] * mScale;
+				double floor	= math<double>::floor( value );
+				c[ i ]			= (int64_t)floor;
+				if ( n != 0 ) {
+					n[ i ] = value - floor <= 0.125 ? c[ i ] - 1 : ( value - floor >= 0.875 ? c[ i ] + 1 : c[ i ] );
+				}
+			} else {
+				float value = position[ i ] + 0.0f;
+				int32_t bits;
+				memcpy( &bits, &value, sizeof( bits ) );
+				c[ i ] = bits;
+				if ( n != 0 ) {
+					n[ i ] = c[ i ];
+				}
+			}
+		}
+	}
+
+	inline uint32_t bucket( const int64_t *c ) const
+	{
+		return ( (uint32_t)c[ 0 ] * 73856093u ^ (uint32_t)c[ 1 ] * 19349663u ^ (uint32_t)c[ 2 ] * 83492791u ) & mMask;
+	}
+
+	// Fills in the bucket of each vertex, for parallelFor()
+	void operator()( size_t begin, size_t end )
+	{
+		int64_t c[ 3 ];
+		for ( size_t v = begin; v < end; ++v ) {
+			cell( mPositions[ v ], c );
+			mKeys[ v ] = bucket( c );
 		}
-		Vec2f texCoord0 = ( vert0.xy() + Vec2f::one() ) * 0.5f;
-		Vec2f texCoord2 = ( vert2.xy() + Vec2f::one() ) * 0.5f;
+	}
+};
 
-		positions.push_back( vert0 );
-		positions.push_back( vert1 );
-		positions.push_back( vert2 );
+// Finds the first vertex each vertex can be welded to, for parallelFor() over buckets
+struct WeldJob
+{
+	const WeldHash		*mHash;
+	float				mPositionEpsilon;
+	float				mNormalEpsilon;
+	float				mTexCoordEpsilon;
+	vector<uint32_t>	*mMatches;
 
-		texCoords.push_back( texCoord0 );
-		texCoords.push_back( texCoord1 );
-		texCoords.push_back( texCoord2 );
+	inline bool matches( const WeldHash::Entry &a, const WeldHash::Entry &b ) const
+	{
+		for ( size_t i = 0; i < 3; ++i ) {
+			if ( math<float>::abs( a.mPosition[ i ] - b.mPosition[ i ] ) > mPositionEpsilon ) {
+				return false;
+			}
+		}
+		for ( size_t i = 0; i < 3; ++i ) {
+			if ( math<float>::abs( a.mNormal[ i ] - b.mNormal[ i ] ) > mNormalEpsilon ) {
+				return false;
+			}
+		}
+		for ( size_t i = 0; i < 2; ++i ) {
+			if ( math<float>::abs( a.mTexCoord[ i ] - b.mTexCoord[ i ] ) > mTexCoordEpsilon ) {
+				return false;
+			}
+		}
+		return true;
+	}
 
-		for ( uint32_t j = 0; j < 3; ++j ) {
-			indices.push_back( i * 3 + j );
-			normals.push_back( norm0 );
+	// Returns the first earlier vertex in bucket b that entry matches, or its own vertex
+	inline uint32_t find( uint32_t b, const WeldHash::Entry &entry ) const
+	{
+		for ( uint32_t i = mHash->mOffsets[ b ]; i < mHash->mOffsets[ b + 1 ]; ++i ) {
+			const WeldHash::Entry &other = mHash->mEntries[ i ];
+			if ( other.mVertex >= entry.mVertex ) {
+				break;
+			}
+			if ( matches( other, entry ) ) {
+				return other.mVertex;
+			}
 		}
+		return entry.mVertex;
+	}
 
+	// Walking vertices bucket by bucket keeps the search of their own cell 
+	// in cache. Neighbors are searched after it, in a fixed order, so the 
+	// result doesn't depend on how buckets are split between threads.
+	void operator()( size_t begin, size_t end )
+	{
+		int64_t cells[ 2 ][ 3 ];
+		for ( size_t i = mHash->mOffsets[ begin ]; i < mHash->mOffsets[ end ]; ++i ) {
+			const WeldHash::Entry &entry = mHash->mEntries[ i ];
+			mHash->cell( entry.mPosition, cells[ 0 ], cells[ 1 ] );
+			uint32_t match = entry.mVertex;
+			for ( size_t n = 0; n < 8 && match == entry.mVertex; ++n ) {
+				int64_t c[ 3 ];
+				bool valid = true;
+				for ( size_t axis = 0; axis < 3; ++axis ) {
+					size_t side	= ( n >> axis ) & 1;
+					c[ axis ]	= cells[ side ][ axis ];
+					valid		= valid && ( side == 0 || cells[ 1 ][ axis ] != cells[ 0 ][ axis ] );
+				}
+				if ( valid ) {
+					match = find( mHash->bucket( c ), entry );
+				}
+			}
+			( *mMatches )[ entry.mVertex ] = match;
+		}
 	}
+};
 
-	TriMesh mesh = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
+// Finds the vertices to weld, returning the new vertex count. Indices are 
+// rewritten, and remap holds the new position of each vertex kept.
+size_t weld( vector<uint32_t> &indices, const vector<Vec3f> &positions, const vector<Vec3f> &normals, 
+	const vector<Vec2f> &texCoords, float positionEpsilon, float normalEpsilon, float texCoordEpsilon, 
+	uint32_t numThreads, vector<uint32_t> *remap )
+{
+	size_t numVertices = positions.size();
+	remap->clear();
+	if ( numVertices == 0 ) {
+		return 0;
+	}
 
-	indices.clear();
-	normals.clear();
-	positions.clear();
-	texCoords.clear();
+	WeldHash hash;
+	hash.mPositions	= &positions[ 0 ];
+	hash.mScale		= positionEpsilon > 0.0f ? 0.125 / positionEpsilon : 0.0;
+	hash.mMask		= 1;
+	while ( hash.mMask < numVertices ) {
+		hash.mMask <<= 1;
+	}
+	hash.mMask -= 1;
+	hash.mKeys.resize( numVertices );
+	parallelFor( numVertices, 65536, numThreads, hash );
+
+	hash.mOffsets.assign( hash.mMask + 2, 0 );
+	for ( size_t v = 0; v < numVertices; ++v ) {
+		++hash.mOffsets[ hash.mKeys[ v ] + 1 ];
+	}
+	for ( size_t b = 0; b <= hash.mMask; ++b ) {
+		hash.mOffsets[ b + 1 ] += hash.mOffsets[ b ];
+	}
+
+	// Missing attributes compare as zero
+	bool hasNormals		= normals.size() == numVertices;
+	bool hasTexCoords	= texCoords.size() == numVertices;
+	hash.mEntries.resize( numVertices );
+	vector<uint32_t> fill( hash.mOffsets.begin(), hash.mOffsets.end() - 1 );
+	for ( size_t v = 0; v < numVertices; ++v ) {
+		WeldHash::Entry &entry	= hash.mEntries[ fill[ hash.mKeys[ v ] ]++ ];
+		entry.mPosition			= positions[ v ];
+		entry.mNormal			= hasNormals ? normals[ v ] : Vec3f::zero();
+		entry.mTexCoord			= hasTexCoords ? texCoords[ v ] : Vec2f::zero();
+		entry.mVertex			= (uint32_t)v;
+	}
+
+	vector<uint32_t> matches( numVertices );
+	WeldJob job;
+	job.mHash				= &hash;
+	job.mPositionEpsilon	= math<float>::max( positionEpsilon, 0.0f );
+	job.mNormalEpsilon		= math<float>::max( normalEpsilon, 0.0f );
+	job.mTexCoordEpsilon	= math<float>::max( texCoordEpsilon, 0.0f );
+	job.mMatches			= &matches;
+	parallelFor( (size_t)hash.mMask + 1, 4096, numThreads, job );
+
+	// Matches always point back, so one forward pass resolves every chain
+	remap->assign( numVertices, kUnusedVertex );
+	uint32_t count = 0;
+	for ( size_t v = 0; v < numVertices; ++v ) {
+		if ( matches[ v ] == v ) {
+			( *remap )[ v ]	= count;
+			matches[ v ]	= count++;
+		} else {
+			matches[ v ] = matches[ matches[ v ] ];
+		}
+	}
+	for ( size_t i = 0; i < indices.size(); ++i ) {
+		indices[ i ] = matches[ indices[ i ] ];
+	}
+	return count;
+}
 
-	return mesh;
 }
 
-TriMesh MeshHelper::createConeTriMesh( uint32_t segments, bool closeBase )
+size_t MeshHelper::weldVertices( vector<uint32_t> &indices, vector<Vec3f> &positions, vector<Vec3f> &normals, 
+	vector<Vec2f> &texCoords, float positionEpsilon, float normalEpsilon, float texCoordEpsilon, uint32_t numThreads )
 {
-	vector<uint32_t> indices;
-	vector<Vec3f> normals;
-	vector<Vec3f> positions;
-	vector<Vec3f> srcPositions;
-	vector<Vec2f> srcTexCoords;
-	vector<Vec2f> texCoords;
+	vector<uint32_t> remap;
+	size_t count = weld( indices, positions, normals, texCoords, positionEpsilon, normalEpsilon, texCoordEpsilon, 
+		numThreads, &remap );
+	remapVertices( positions, remap, count );
+	remapVertices( normals, remap, count );
+	remapVertices( texCoords, remap, count );
+	return count;
+}
 
-	float delta = 1.0f / (float)segments;
+size_t MeshHelper::weldVertices( TriMesh &mesh, float positionEpsilon, float normalEpsilon, float texCoordEpsilon, 
+	uint32_t numThreads )
+{
+	vector<uint32_t> remap;
+	size_t count = weld( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords(), 
+		positionEpsilon, normalEpsilon, texCoordEpsilon, numThreads, &remap );
+	remapVertices( mesh.getVertices(), remap, count );
+	remapVertices( mesh.getNormals(), remap, count );
+	remapVertices( mesh.getTexCoords(), remap, count );
+	remapVertices( mesh.getColorsRGB(), remap, count );
+	remapVertices( mesh.getColorsRGBA(), remap, count );
+	return count;
+}
 
-	for ( uint32_t p = 0; p < 2; p++ ) {
-		float radius = p == 0 ? 1.0f : 0.0f;
+namespace
+{
 
-		uint32_t i = 0;
-		for ( float theta = delta; i < segments; i++, theta += delta ) {
+// Sum of squared distances to planes, each weighted by the area it stands for, 
+// as a symmetric 4x4 matrix. The total weight turns the sum into a mean.
+struct Quadric
+{
+	double	mXX, mXY, mXZ, mXW, mYY, mYZ, mYW, mZZ, mZW, mWW;
+	double	mWeight;
 
-			float t = 2.0f * (float)M_PI * theta;
-			float cosT = math<float>::cos( t );
-			float sinT = math<float>::sin( t );
-			Vec3f position( 
-				cosT * radius, 
-				(float)p, 
-				sinT * radius 
-				);
-			srcPositions.push_back( position );
+	Quadric()
+		: mXX( 0.0 ), mXY( 0.0 ), mXZ( 0.0 ), mXW( 0.0 ), mYY( 0.0 ), mYZ( 0.0 ), mYW( 0.0 ), 
+		mZZ( 0.0 ), mZW( 0.0 ), mWW( 0.0 ), mWeight( 0.0 )
+	{
+	}
 
-			Vec2f texCoord( theta, position.y );
-			srcTexCoords.push_back( texCoord );
-		}
+	// Plane with unit normal through point
+	Quadric( const Vec3f &normal, const Vec3f &point, double weight )
+	{
+		double a	= normal.x;
+		double b	= normal.y;
+		double c	= normal.z;
+		double d	= -( a * point.x + b * point.y + c * point.z );
+		mXX			= weight * a * a;
+		mXY			= weight * a * b;
+		mXZ			= weight * a * c;
+		mXW			= weight * a * d;
+		mYY			= weight * b * b;
+		mYZ			= weight * b * c;
+		mYW			= weight * b * d;
+		mZZ			= weight * c * c;
+		mZW			= weight * c * d;
+		mWW			= weight * d * d;
+		mWeight		= weight;
+	}
 
+	Quadric &operator+=( const Quadric &rhs )
+	{
+		mXX		+= rhs.mXX;
+		mXY		+= rhs.mXY;
+		mXZ		+= rhs.mXZ;
+		mXW		+= rhs.mXW;
+		mYY		+= rhs.mYY;
+		mYZ		+= rhs.mYZ;
+		mYW		+= rhs.mYW;
+		mZZ		+= rhs.mZZ;
+		mZW		+= rhs.mZW;
+		mWW		+= rhs.mWW;
+		mWeight	+= rhs.mWeight;
+		return *this;
 	}
 
-	srcPositions.push_back( Vec3f( 0.0f, 0.0f, 0.0f ) );
-	srcPositions.push_back( Vec3f( 0.0f, 1.0f, 0.0f ) );
-	srcTexCoords.push_back( Vec2f( 0.0f, 0.0f ) );
-	srcTexCoords.push_back( Vec2f( 0.0f, 1.0f ) );
-	int32_t bottomCenter = (int32_t)srcPositions.size() - 1;
-	int32_t topCenter = bottomCenter - 1;
+	// Mean squared distance of p from the planes
+	double eval( const Vec3f &p ) const
+	{
+		double x	= p.x;
+		double y	= p.y;
+		double z	= p.z;
+		double sum	= x * ( mXX * x + 2.0 * ( mXY * y + mXZ * z + mXW ) ) + y * ( mYY * y + 2.0 * ( mYZ * z + mYW ) ) + 
+			z * ( mZZ * z + 2.0 * mZW ) + mWW;
+		return mWeight > 0.0 ? std::max( sum, 0.0 ) / mWeight : 0.0;
+	}
+};
 
-	Vec3f offset( 0.0f, -0.5f, 0.0f );
+// The cheapest collapse of a vertex onto a neighbor. Entries 
+// whose version no longer matches their vertex's are stale.
+struct Collapse
+{
+	float		mCost;
+	uint32_t	mVertex;
+	uint32_t	mTarget;
+	uint32_t	mVersion;
 
-	for ( uint32_t t = 0; t < segments; t++ ) {
-		uint32_t n = t + 1 >= segments ? 0 : t + 1;
+	// Puts the cheapest collapse on top of a priority_queue
+	bool operator<( const Collapse &rhs ) const
+	{
+		return mCost > rhs.mCost;
+	}
+};
 
-		uint32_t index0 = t;
-		uint32_t index1 = n;
-		uint32_t index2 = segments + t;
-		uint32_t index3 = segments + n;
+// A vertex next to another, with the number of triangles they share
+struct Neighbor
+{
+	uint32_t	mVertex;
+	uint32_t	mCount;
+};
 
-		Vec3f vert0 = srcPositions[ index0 ];
-		Vec3f vert1 = srcPositions[ index1 ];
-		Vec3f vert2 = srcPositions[ index2 ];
-		Vec3f vert3 = srcPositions[ index3 ];
-
-		Vec2f texCoord0 = srcTexCoords[ index0 ];
-		Vec2f texCoord1 = srcTexCoords[ index1 ];
-		Vec2f texCoord2 = srcTexCoords[ index2 ];
-		Vec2f texCoord3 = srcTexCoords[ index3 ];
-
-		Vec3f norm0 = vert0.normalized();
-		Vec3f norm1 = vert1.normalized();
-		Vec3f norm2 = norm0;
-		Vec3f norm3 = norm1;
-
-		normals.push_back( norm0 );
-		normals.push_back( norm2 );
-		normals.push_back( norm1 );
-		normals.push_back( norm1 );
-		normals.push_back( norm2 );
-		normals.push_back( norm3 );
-
-		positions.push_back( vert0 + offset );
-		positions.push_back( vert2 + offset );
-		positions.push_back( vert1 + offset );
-		positions.push_back( vert1 + offset );
-		positions.push_back( vert2 + offset );
-		positions.push_back( vert3 + offset );
-
-		texCoords.push_back( texCoord0 );
-		texCoords.push_back( texCoord2 );
-		texCoords.push_back( texCoord1 );
-		texCoords.push_back( texCoord1 );
-		texCoords.push_back( texCoord2 );
-		texCoords.push_back( texCoord3 );
-	}
+/* Edge collapse simplifier. Its vertices are wedges, mesh vertices with every 
+   attribute equal. Each collapse moves a vertex onto a neighbor, so the vertices 
+   left keep their attributes. Wedges sharing their position with another lie 
+   on a normal or texture seam and never move, which keeps seams closed. Border 
+   vertices only move along the border. Triangle lists are copied to the end of 
+   a pool when vertices merge, so each vertex's list stays short. */
+struct Simplifier
+{
+	vector<uint32_t>	mIndices;
+	vector<Vec3f>		mPositions;
+	vector<Vec3f>		mNormals;
+	vector<Vec2f>		mTexCoords;
+	vector<bool>		mLocked;
+	vector<Quadric>		mQuadrics;
+	vector<bool>		mCollapsed;
+	vector<uint32_t>	mVersions;
+	vector<uint32_t>	mBegin;
+	vector<uint32_t>	mCount;
+	vector<uint32_t>	mPool;
+	vector<bool>		mRemoved;
+	size_t				mNumTriangles;
+	double				mAttributeScale;
 
-	if ( closeBase ) {
-		Vec3f normal( 0.0f, -1.0f, 0.0f );
-		for ( uint32_t t = 0; t < segments; t++ ) {
-			uint32_t n = t + 1 >= segments ? 0 : t + 1;
+	// Border planes are weighted as a strip this many times the edge length wide
+	static const double kBorderWeight;
 
-			normals.push_back( normal );
-			normals.push_back( normal );
-			normals.push_back( normal );
+	void gatherRing( uint32_t v, vector<Neighbor> *ring )
+	{
+		ring->clear();
+		for ( uint32_t a = mBegin[ v ]; a < mBegin[ v ] + mCount[ v ]; ++a ) {
+			uint32_t t = mPool[ a ];
+			if ( mRemoved[ t ] ) {
+				continue;
+			}
+			for ( size_t c = 0; c < 3; ++c ) {
+				uint32_t n = mIndices[ t * 3 + c ];
+				if ( n == v ) {
+					continue;
+				}
+				size_t i = 0;
+				while ( i < ring->size() && ( *ring )[ i ].mVertex != n ) {
+					++i;
+				}
+				if ( i == ring->size() ) {
+					Neighbor neighbor = { n, 0 };
+					ring->push_back( neighbor );
+				}
+				++( *ring )[ i ].mCount;
+			}
+		}
+	}
 
-			positions.push_back( srcPositions[ topCenter ] + offset );
-			positions.push_back( srcPositions[ t ] + offset );
-			positions.push_back( srcPositions[ n ] + offset );
+	// Sums the planes of each triangle around v, and of its border edges
+	void initQuadric( uint32_t v, vector<Neighbor> *ring )
+	{
+		gatherRing( v, ring );
+		Quadric &quadric = mQuadrics[ v ];
+		for ( uint32_t a = mBegin[ v ]; a < mBegin[ v ] + mCount[ v ]; ++a ) {
+			uint32_t t		= mPool[ a ];
+			uint32_t c		= mIndices[ t * 3 ] == v ? 0 : ( mIndices[ t * 3 + 1 ] == v ? 1 : 2 );
+			uint32_t next	= mIndices[ t * 3 + ( c + 1 ) % 3 ];
+			uint32_t prev	= mIndices[ t * 3 + ( c + 2 ) % 3 ];
+			Vec3f normal	= ( mPositions[ next ] - mPositions[ v ] ).cross( mPositions[ prev ] - mPositions[ v ] );
+			float area		= normal.length() * 0.5f;
+			if ( area <= 0.0f ) {
+				continue;
+			}
+			normal /= area * 2.0f;
+			quadric += Quadric( normal, mPositions[ v ], area );
 
-			texCoords.push_back( srcTexCoords[ topCenter ] );
-			texCoords.push_back( srcTexCoords[ topCenter ] );
-			texCoords.push_back( srcTexCoords[ topCenter ] );
+			for ( size_t e = 0; e < 2; ++e ) {
+				uint32_t other = e == 0 ? next : prev;
+				for ( size_t i = 0; i < ring->size(); ++i ) {
+					if ( ( *ring )[ i ].mVertex == other && ( *ring )[ i ].mCount == 1 ) {
+						Vec3f edge	= mPositions[ other ] - mPositions[ v ];
+						Vec3f side	= edge.cross( normal );
+						if ( side.lengthSquared() > 0.0f ) {
+							quadric += Quadric( side.normalized(), mPositions[ v ], kBorderWeight * edge.lengthSquared() );
+						}
+					}
+				}
+			}
 		}
 	}
 
-	for ( uint32_t i = 0; i < positions.size(); i++ ) {
-		indices.push_back( i );
+	double cost( uint32_t v, uint32_t target ) const
+	{
+		Quadric quadric = mQuadrics[ v ];
+		quadric += mQuadrics[ target ];
+		double attributes = 0.0;
+		if ( !mNormals.empty() ) {
+			attributes += ( mNormals[ v ] - mNormals[ target ] ).lengthSquared();
+		}
+		if ( !mTexCoords.empty() ) {
+			attributes += ( mTexCoords[ v ] - mTexCoords[ target ] ).lengthSquared();
+		}
+		return quadric.eval( mPositions[ target ] ) + mAttributeScale * attributes;
 	}
 
-	TriMesh mesh = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
-		
-	indices.clear();
-	normals.clear();
-	positions.clear();
-	srcPositions.clear();
-	srcTexCoords.clear();
-	texCoords.clear();
+	/* A collapse is allowed when no triangle left around v flips or becomes 
+	   degenerate, and when v and target have no neighbors in common besides 
+	   the corners of the triangles they share, so the surface isn't pinched. */
+	bool canCollapse( uint32_t v, uint32_t target, const vector<Neighbor> &ring, uint32_t shared, 
+		vector<Neighbor> *targetRing )
+	{
+		for ( uint32_t a = mBegin[ v ]; a < mBegin[ v ] + mCount[ v ]; ++a ) {
+			uint32_t t = mPool[ a ];
+			if ( mRemoved[ t ] ) {
+				continue;
+			}
+			uint32_t corners[ 3 ];
+			for ( size_t c = 0; c < 3; ++c ) {
+				corners[ c ] = mIndices[ t * 3 + c ];
+			}
+			if ( corners[ 0 ] == target || corners[ 1 ] == target || corners[ 2 ] == target ) {
+				continue;
+			}
+			Vec3f before[ 3 ];
+			Vec3f after[ 3 ];
+			for ( size_t c = 0; c < 3; ++c ) {
+				before[ c ]	= mPositions[ corners[ c ] ];
+				after[ c ]	= corners[ c ] == v ? mPositions[ target ] : before[ c ];
+			}
+			Vec3f normal = ( before[ 1 ] - before[ 0 ] ).cross( before[ 2 ] - before[ 0 ] );
+			if ( normal.dot( ( after[ 1 ] - after[ 0 ] ).cross( after[ 2 ] - after[ 0 ] ) ) <= 0.0f ) {
+				return false;
+			}
+		}
 
-	return mesh;
-}
+		gatherRing( target, targetRing );
+		uint32_t common = 0;
+		for ( size_t i = 0; i < ring.size(); ++i ) {
+			for ( size_t j = 0; j < targetRing->size(); ++j ) {
+				if ( ring[ i ].mVertex == ( *targetRing )[ j ].mVertex ) {
+					++common;
+				}
+			}
+		}
+		return common <= shared;
+	}
 
-TriMesh MeshHelper::createCubeTriMesh()
-{
-	vector<uint32_t> indices;
-	vector<Vec3f> normals;
-	vector<Vec3f> positions;
-	vector<Vec2f> texCoords;
+	/* Finds the cheapest collapse of v, which is only checked with canCollapse() 
+	   when checked is set. Its target is kUnusedVertex when there is none. */
+	Collapse findCollapse( uint32_t v, bool checked, vector<Neighbor> *ring, vector<Neighbor> *targetRing, 
+		vector<pair<double, uint32_t> > *candidates )
+	{
+		Collapse collapse	= { 0.0f, v, kUnusedVertex, mVersions[ v ] };
+		if ( mLocked[ v ] ) {
+			return collapse;
+		}
 
-	Vec3f size = Vec3f::one() * 0.5f;
-	Vec3f pos0 = Vec3f( 1.0f, 1.0f, 1.0f ) * size;
-	Vec3f pos1 = Vec3f( 1.0f, -1.0f, 1.0f ) * size;
-	Vec3f pos2 = Vec3f( 1.0f, -1.0f, -1.0f ) * size;
-	Vec3f pos3 = Vec3f( 1.0f, 1.0f, -1.0f ) * size;
-	Vec3f pos4 = Vec3f( -1.0f, 1.0f, -1.0f ) * size;
-	Vec3f pos5 = Vec3f( -1.0f, 1.0f, 1.0f ) * size;
-	Vec3f pos6 = Vec3f( -1.0f, -1.0f, -1.0f ) * size;
-	Vec3f pos7 = Vec3f( -1.0f, -1.0f, 1.0f ) * size;
-
-	Vec3f norm0( 1.0f, 0.0f, 0.0f );
-	Vec3f norm1( 0.0f, 1.0f, 0.0f );
-	Vec3f norm2( 0.0f, 0.0f, 1.0f );
-	Vec3f norm3( -1.0f, 0.0f, 0.0f ); 
-	Vec3f norm4( 0.0f, -1.0f, 0.0f ); 
-	Vec3f norm5( 0.0f, 0.0f, -1.0f ); 
-
-	positions.push_back( pos0 ); 
-	positions.push_back( pos1 ); 	
-	positions.push_back( pos2 ); 	
-	positions.push_back( pos3 );
-
-	positions.push_back( pos0 ); 
-	positions.push_back( pos3 ); 	
-	positions.push_back( pos4 ); 	
-	positions.push_back( pos5 );
-
-	positions.push_back( pos0 ); 	
-	positions.push_back( pos5 ); 	
-	positions.push_back( pos7 ); 	
-	positions.push_back( pos1 );
-
-	positions.push_back( pos5 ); 	
-	positions.push_back( pos4 ); 	
-	positions.push_back( pos6 ); 	
-	positions.push_back( pos7 );
-
-	positions.push_back( pos6 ); 	
-	positions.push_back( pos2 ); 
-	positions.push_back( pos1 ); 	
-	positions.push_back( pos7 );
-
-	positions.push_back( pos2 ); 	
-	positions.push_back( pos6 ); 	
-	positions.push_back( pos4 ); 	
-	positions.push_back( pos3 );
-
-	for ( uint8_t i = 0; i < 4; i++ ) {
-		normals.push_back( norm0 );
-	}
-	for ( uint8_t i = 0; i < 4; i++ ) {
-		normals.push_back( norm1 );
-	}
-	for ( uint8_t i = 0; i < 4; i++ ) {
-		normals.push_back( norm2 );
-	}
-	for ( uint8_t i = 0; i < 4; i++ ) {
-		normals.push_back( norm3 );
-	}
-	for ( uint8_t i = 0; i < 4; i++ ) {
-		normals.push_back( norm4 );
-	}
-	for ( uint8_t i = 0; i < 4; i++ ) {
-		normals.push_back( norm5 );
-	}
-
-	Vec2f texCoord0( 0.0f, 0.0f );
-	Vec2f texCoord1( 1.0f, 0.0f );
-	Vec2f texCoord2( 1.0f, 1.0f );
-	Vec2f texCoord3( 0.0f, 1.0f );
-
-	texCoords.push_back( texCoord3 );
-	texCoords.push_back( texCoord2 );
-	texCoords.push_back( texCoord1 );
-	texCoords.push_back( texCoord0 );
-
-	texCoords.push_back( texCoord2 );
-	texCoords.push_back( texCoord1 );
-	texCoords.push_back( texCoord0 );
-	texCoords.push_back( texCoord3 );
-
-	texCoords.push_back( texCoord3 );
-	texCoords.push_back( texCoord2 );
-	texCoords.push_back( texCoord1 );
-	texCoords.push_back( texCoord0 );
-
-	texCoords.push_back( texCoord2 );
-	texCoords.push_back( texCoord1 );
-	texCoords.push_back( texCoord0 );
-	texCoords.push_back( texCoord3 );
-
-	texCoords.push_back( texCoord1 );
-	texCoords.push_back( texCoord0 );
-	texCoords.push_back( texCoord3 );
-	texCoords.push_back( texCoord2 );
-		
-	texCoords.push_back( texCoord1 );
-	texCoords.push_back( texCoord0 );			
-	texCoords.push_back( texCoord3 );
-	texCoords.push_back( texCoord2 );
-
-	indices.push_back( 0 );
-	indices.push_back( 1 );
-	indices.push_back( 2 );
-	indices.push_back( 0 );
-	indices.push_back( 2 );
-	indices.push_back( 3 );
-		
-	indices.push_back( 4 );
-	indices.push_back( 5 );
-	indices.push_back( 6 );
-	indices.push_back( 4 );
-	indices.push_back( 6 );
-	indices.push_back( 7 );
-		
-	indices.push_back( 8 );
-	indices.push_back( 9 );
-	indices.push_back( 10 );
-	indices.push_back( 8 );
-	indices.push_back( 10 );
-	indices.push_back( 11 );
-		
-	indices.push_back( 12 );
-	indices.push_back( 13 );
-	indices.push_back( 14 );
-	indices.push_back( 12 );
-	indices.push_back( 14 );
-	indices.push_back( 15 );
-		
-	indices.push_back( 16 );
-	indices.push_back( 17 );
-	indices.push_back( 18 );
-	indices.push_back( 16 );
-	indices.push_back( 18 );
-	indices.push_back( 19 );
-		
-	indices.push_back( 20 );
-	indices.push_back( 21 );
-	indices.push_back( 22 );
-	indices.push_back( 20 );
-	indices.push_back( 22 );
-	indices.push_back( 23 );
-
-	TriMesh mesh = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
-
-	indices.clear();
-	normals.clear();
-	positions.clear();
-	texCoords.clear();
+		gatherRing( v, ring );
+		bool border = false;
+		for ( size_t i = 0; i < ring->size(); ++i ) {
+			if ( ( *ring )[ i ].mCount > 2 ) {
+				return collapse;
+			}
+			border = border || ( *ring )[ i ].mCount == 1;
+		}
 
-	return mesh;
-}
+		candidates->clear();
+		for ( size_t i = 0; i < ring->size(); ++i ) {
+			if ( !border || ( *ring )[ i ].mCount == 1 ) {
+				candidates->push_back( make_pair( cost( v, ( *ring )[ i ].mVertex ), (uint32_t)i ) );
+			}
+		}
+		std::sort( candidates->begin(), candidates->end() );
+		for ( size_t i = 0; i < candidates->size(); ++i ) {
+			const Neighbor &target = ( *ring )[ ( *candidates )[ i ].second ];
+			if ( !checked || canCollapse( v, target.mVertex, *ring, target.mCount, targetRing ) ) {
+				collapse.mCost		= (float)( *candidates )[ i ].first;
+				collapse.mTarget	= target.mVertex;
+				break;
+			}
+		}
+		return collapse;
+	}
 
-TriMesh MeshHelper::createCylinderTriMesh( uint32_t segments, float topRadius, float baseRadius, bool closeTop, bool closeBase )
-{
-	vector<uint32_t> indices;
-	vector<Vec3f> normals;
-	vector<Vec3f> positions;
-	vector<Vec3f> srcNormals;
-	vector<Vec3f> srcPositions;
-	vector<Vec2f> srcTexCoords;
-	vector<Vec2f> texCoords;
+	// Moves v onto target, removing the triangles they share
+	void collapse( uint32_t v, uint32_t target )
+	{
+		for ( uint32_t a = mBegin[ v ]; a < mBegin[ v ] + mCount[ v ]; ++a ) {
+			uint32_t t = mPool[ a ];
+			if ( mRemoved[ t ] ) {
+				continue;
+			}
+			uint32_t *corners = &mIndices[ t * 3 ];
+			if ( corners[ 0 ] == target || corners[ 1 ] == target || corners[ 2 ] == target ) {
+				mRemoved[ t ] = true;
+				--mNumTriangles;
+				continue;
+			}
+			for ( size_t c = 0; c < 3; ++c ) {
+				if ( corners[ c ] == v ) {
+					corners[ c ] = target;
+				}
+			}
+		}
+		mCollapsed[ v ] = true;
+		mQuadrics[ target ] += mQuadrics[ v ];
+
+		if ( mPool.size() > mIndices.size() * 2 ) {
+			compactPool();
+		}
+		uint32_t begin = (uint32_t)mPool.size();
+		for ( size_t i = 0; i < 2; ++i ) {
+			uint32_t w = i == 0 ? target : v;
+			for ( uint32_t a = mBegin[ w ]; a < mBegin[ w ] + mCount[ w ]; ++a ) {
+				uint32_t t = mPool[ a ];
+				if ( !mRemoved[ t ] ) {
+					mPool.push_back( t );
+				}
+			}
+		}
+		mBegin[ target ]	= begin;
+		mCount[ target ]	= (uint32_t)mPool.size() - begin;
+		mCount[ v ]			= 0;
+	}
 
-	float delta = 1.0f / (float)segments;
+	// Drops removed triangles and lists no longer in use from the pool
+	void compactPool()
+	{
+		vector<uint32_t> pool;
+		pool.reserve( mIndices.size() );
+		for ( size_t v = 0; v < mBegin.size(); ++v ) {
+			uint32_t begin = (uint32_t)pool.size();
+			for ( uint32_t a = mBegin[ v ]; a < mBegin[ v ] + mCount[ v ]; ++a ) {
+				if ( !mRemoved[ mPool[ a ] ] ) {
+					pool.push_back( mPool[ a ] );
+				}
+			}
+			mBegin[ v ] = begin;
+			mCount[ v ] = (uint32_t)pool.size() - begin;
+		}
+		mPool.swap( pool );
+	}
+};
 
-	for ( uint32_t p = 0; p < 2; p++ ) {
-		uint32_t t = 0;
-		float radius = p == 0 ? baseRadius : topRadius;
-		for ( float theta = delta; t < segments; t++, theta += delta ) {
-			float t = 2.0f * (float)M_PI * theta;
-			Vec3f position( 
-				math<float>::cos( t ) * radius, 
-				(float)p - 0.5f, 
-				math<float>::sin( t ) * radius
-				);
-			srcPositions.push_back( position );
+const double Simplifier::kBorderWeight = 10.0;
 
-			Vec3f normal = position.normalized();
-			normal.y = 0.0f;
-			srcNormals.push_back( normal );
+// Fills in the quadric of each vertex, for parallelFor()
+struct QuadricJob
+{
+	Simplifier	*mSimplifier;
 
-			Vec2f texCoord( theta, position.y + 0.5f );
-			srcTexCoords.push_back( texCoord );
+	void operator()( size_t begin, size_t end )
+	{
+		vector<Neighbor> ring;
+		for ( size_t v = begin; v < end; ++v ) {
+			mSimplifier->initQuadric( (uint32_t)v, &ring );
 		}
 	}
+};
 
-	srcNormals.push_back( Vec3f( 0.0f, -1.0f, 0.0f ) );
-	srcNormals.push_back( Vec3f( 0.0f, 1.0f, 0.0f ) );
-	srcPositions.push_back( Vec3f( 0.0f, -0.5f, 0.0f ) );
-	srcPositions.push_back( Vec3f( 0.0f, 0.5f, 0.0f ) );
-	srcTexCoords.push_back( Vec2f( 0.0f, 0.0f ) );
-	srcTexCoords.push_back( Vec2f( 0.0f, 1.0f ) );
-	int32_t topCenter = (int32_t)srcPositions.size() - 1;
-	int32_t bottomCenter = topCenter - 1;
+// Finds the first collapse of each vertex, for parallelFor()
+struct CollapseJob
+{
+	Simplifier			*mSimplifier;
+	vector<Collapse>	*mCollapses;
 
-	if ( closeTop ) {
-		for ( uint32_t t = 0; t < segments; t++ ) {
-			uint32_t n = t + 1 >= segments ? 0 : t + 1;
+	void operator()( size_t begin, size_t end )
+	{
+		vector<Neighbor> ring;
+		vector<Neighbor> targetRing;
+		vector<pair<double, uint32_t> > candidates;
+		for ( size_t v = begin; v < end; ++v ) {
+			( *mCollapses )[ v ] = mSimplifier->findCollapse( (uint32_t)v, false, &ring, &targetRing, &candidates );
+		}
+	}
+};
 
-			normals.push_back( srcNormals[ topCenter ] );
-			normals.push_back( srcNormals[ topCenter ] );
-			normals.push_back( srcNormals[ topCenter ] );
+}
 
-			positions.push_back( srcPositions[ topCenter ] );
-			positions.push_back( srcPositions[ segments + t ] );
-			positions.push_back( srcPositions[ segments + n ] );
+float MeshHelper::simplify( TriMesh &mesh, size_t targetTriangles, float maxError, float attributeWeight, 
+	uint32_t numThreads )
+{
+	vector<uint32_t> &indices	= mesh.getIndices();
+	size_t numVertices			= mesh.getNumVertices();
+	size_t numTriangles			= indices.size() / 3;
+	if ( numTriangles <= targetTriangles || numVertices == 0 ) {
+		return 0.0f;
+	}
 
-			texCoords.push_back( srcTexCoords[ topCenter ] );
-			texCoords.push_back( srcTexCoords[ topCenter ] );
-			texCoords.push_back( srcTexCoords[ topCenter ] );
+	// Welding exactly with an identity index list numbers each vertex's wedge, 
+	// then each vertex's position. Positions with several wedges are seams.
+	vector<uint32_t> wedges( numVertices );
+	vector<uint32_t> positions( numVertices );
+	for ( size_t v = 0; v < numVertices; ++v ) {
+		wedges[ v ]		= (uint32_t)v;
+		positions[ v ]	= (uint32_t)v;
+	}
+	vector<uint32_t> remap;
+	size_t numWedges = weld( wedges, mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords(), 0.0f, 0.0f, 0.0f, 
+		numThreads, &remap );
+	vector<uint32_t> firstVertex( numWedges );
+	for ( size_t v = 0; v < numVertices; ++v ) {
+		if ( remap[ v ] != kUnusedVertex ) {
+			firstVertex[ remap[ v ] ] = (uint32_t)v;
 		}
 	}
+	size_t numPositions = weld( positions, mesh.getVertices(), vector<Vec3f>(), vector<Vec2f>(), 0.0f, 0.0f, 0.0f, 
+		numThreads, &remap );
+	vector<uint32_t> wedgesAtPosition( numPositions, 0 );
+	for ( size_t w = 0; w < numWedges; ++w ) {
+		++wedgesAtPosition[ positions[ firstVertex[ w ] ] ];
+	}
 
-	for ( uint32_t t = 0; t < segments; t++ ) {
-		uint32_t n = t + 1 >= segments ? 0 : t + 1;
-		
-		uint32_t index0 = t;
-		uint32_t index1 = n;
-		uint32_t index2 = segments + t;
-		uint32_t index3 = segments + n;
+	bool hasNormals		= mesh.getNormals().size() == numVertices;
+	bool hasTexCoords	= mesh.getTexCoords().size() == numVertices;
+	Simplifier simplifier;
+	simplifier.mIndices.resize( numTriangles * 3 );
+	for ( size_t i = 0; i < numTriangles * 3; ++i ) {
+		simplifier.mIndices[ i ] = wedges[ indices[ i ] ];
+	}
+	simplifier.mPositions.resize( numWedges );
+	simplifier.mNormals.resize( hasNormals ? numWedges : 0 );
+	simplifier.mTexCoords.resize( hasTexCoords ? numWedges : 0 );
+	simplifier.mLocked.resize( numWedges );
+	simplifier.mCollapsed.assign( numWedges, false );
+	for ( size_t w = 0; w < numWedges; ++w ) {
+		uint32_t v = firstVertex[ w ];
+		simplifier.mPositions[ w ] = mesh.getVertices()[ v ];
+		if ( hasNormals ) {
+			simplifier.mNormals[ w ] = mesh.getNormals()[ v ];
+		}
+		if ( hasTexCoords ) {
+			simplifier.mTexCoords[ w ] = mesh.getTexCoords()[ v ];
+		}
+		simplifier.mLocked[ w ] = wedgesAtPosition[ positions[ v ] ] > 1;
+	}
+	simplifier.mQuadrics.resize( numWedges );
+	simplifier.mVersions.assign( numWedges, 0 );
+	simplifier.mRemoved.assign( numTriangles, false );
+	simplifier.mNumTriangles = numTriangles;
+
+	// Attribute differences are measured against the size of the mesh
+	Vec3f minimum	= simplifier.mPositions[ 0 ];
+	Vec3f maximum	= minimum;
+	for ( size_t w = 1; w < numWedges; ++w ) {
+		const Vec3f &p = simplifier.mPositions[ w ];
+		minimum = Vec3f( math<float>::min( minimum.x, p.x ), math<float>::min( minimum.y, p.y ), math<float>::min( minimum.z, p.z ) );
+		maximum = Vec3f( math<float>::max( maximum.x, p.x ), math<float>::max( maximum.y, p.y ), math<float>::max( maximum.z, p.z ) );
+	}
+	double attributeScale		= (double)attributeWeight * ( maximum - minimum ).length();
+	simplifier.mAttributeScale	= attributeScale * attributeScale;
 
-		normals.push_back( srcNormals[ index0 ] );
-		normals.push_back( srcNormals[ index2 ] );
-		normals.push_back( srcNormals[ index1 ] );
-		normals.push_back( srcNormals[ index1 ] );
-		normals.push_back( srcNormals[ index2 ] );
-		normals.push_back( srcNormals[ index3 ] );
+	{
+		VertexAdjacency adjacency( simplifier.mIndices, numWedges );
+		simplifier.mPool.swap( adjacency.mTriangles );
+		simplifier.mBegin.assign( adjacency.mOffsets.begin(), adjacency.mOffsets.end() - 1 );
+		simplifier.mCount.resize( numWedges );
+		for ( size_t w = 0; w < numWedges; ++w ) {
+			simplifier.mCount[ w ] = adjacency.end( w ) - adjacency.begin( w );
+		}
+	}
 
-		positions.push_back( srcPositions[ index0 ] );
-		positions.push_back( srcPositions[ index2 ] );
-		positions.push_back( srcPositions[ index1 ] );
-		positions.push_back( srcPositions[ index1 ] );
-		positions.push_back( srcPositions[ index2 ] );
-		positions.push_back( srcPositions[ index3 ] );
+	QuadricJob quadricJob;
+	quadricJob.mSimplifier = &simplifier;
+	parallelFor( numWedges, 16384, numThreads, quadricJob );
 
-		texCoords.push_back( srcTexCoords[ index0 ] );
-		texCoords.push_back( srcTexCoords[ index2 ] );
-		texCoords.push_back( srcTexCoords[ index1 ] );
-		texCoords.push_back( srcTexCoords[ index1 ] );
-		texCoords.push_back( srcTexCoords[ index2 ] );
-		texCoords.push_back( srcTexCoords[ index3 ] );
+	vector<Collapse> collapses( numWedges );
+	CollapseJob collapseJob;
+	collapseJob.mSimplifier	= &simplifier;
+	collapseJob.mCollapses	= &collapses;
+	parallelFor( numWedges, 16384, numThreads, collapseJob );
+	vector<Collapse> queued;
+	for ( size_t w = 0; w < numWedges; ++w ) {
+		if ( collapses[ w ].mTarget != kUnusedVertex ) {
+			queued.push_back( collapses[ w ] );
+		}
 	}
+	priority_queue<Collapse> queue( less<Collapse>(), queued );
+	vector<Collapse>().swap( queued );
 
-	if ( closeBase ) {
-		for ( uint32_t t = 0; t < segments; t++ ) {
-			uint32_t n = t + 1 >= segments ? 0 : t + 1;
+	/* Collapses are taken cheapest first. After each one, the vertices around it 
+	   look for their cheapest collapse again, and are queued again when it changed, 
+	   leaving their old entry stale. Collapses are only checked once taken, as 
+	   most never make it to the top. collapses holds each vertex's queued entry. */
+	double maxCost	= (double)maxError * (double)maxError;
+	double error	= 0.0;
+	vector<Neighbor> ring;
+	vector<Neighbor> targetRing;
+	vector<Neighbor> changed;
+	vector<pair<double, uint32_t> > candidates;
+	while ( simplifier.mNumTriangles > targetTriangles && !queue.empty() ) {
+		Collapse collapse = queue.top();
+		queue.pop();
+		uint32_t v = collapse.mVertex;
+		if ( simplifier.mCollapsed[ v ] || simplifier.mVersions[ v ] != collapse.mVersion ) {
+			continue;
+		}
+		if ( collapse.mCost > maxCost ) {
+			break;
+		}
 
-			normals.push_back( srcNormals[ bottomCenter ] );
-			normals.push_back( srcNormals[ bottomCenter ] );
-			normals.push_back( srcNormals[ bottomCenter ] );
+		simplifier.gatherRing( v, &ring );
+		uint32_t shared = 0;
+		for ( size_t i = 0; i < ring.size(); ++i ) {
+			if ( ring[ i ].mVertex == collapse.mTarget ) {
+				shared = ring[ i ].mCount;
+			}
+		}
+		if ( shared == 0 || !simplifier.canCollapse( v, collapse.mTarget, ring, shared, &targetRing ) ) {
+			++simplifier.mVersions[ v ];
+			collapses[ v ] = simplifier.findCollapse( v, true, &ring, &targetRing, &candidates );
+			if ( collapses[ v ].mTarget != kUnusedVertex ) {
+				queue.push( collapses[ v ] );
+			}
+			continue;
+		}
 
-			positions.push_back( srcPositions[ bottomCenter ] );
-			positions.push_back( srcPositions[ t ] );
-			positions.push_back( srcPositions[ n ] );
+		simplifier.collapse( v, collapse.mTarget );
+		error = std::max( error, (double)collapse.mCost );
 
-			texCoords.push_back( srcTexCoords[ bottomCenter ] );
-			texCoords.push_back( srcTexCoords[ bottomCenter ] );
-			texCoords.push_back( srcTexCoords[ bottomCenter ] );
+		simplifier.gatherRing( collapse.mTarget, &changed );
+		Neighbor target = { collapse.mTarget, 0 };
+		changed.push_back( target );
+		for ( size_t i = 0; i < changed.size(); ++i ) {
+			uint32_t w		= changed[ i ].mVertex;
+			Collapse next	= simplifier.findCollapse( w, false, &ring, &targetRing, &candidates );
+			if ( next.mTarget == collapses[ w ].mTarget && next.mCost == collapses[ w ].mCost ) {
+				continue;
+			}
+			next.mVersion	= ++simplifier.mVersions[ w ];
+			collapses[ w ]	= next;
+			if ( next.mTarget != kUnusedVertex ) {
+				queue.push( next );
+			}
 		}
 	}
 
-	for ( uint32_t i = 0; i < positions.size(); i++ ) {
-		indices.push_back( i );
+	vector<uint32_t> simplified;
+	simplified.reserve( simplifier.mNumTriangles * 3 );
+	for ( size_t t = 0; t < numTriangles; ++t ) {
+		if ( !simplifier.mRemoved[ t ] ) {
+			for ( size_t c = 0; c < 3; ++c ) {
+				simplified.push_back( firstVertex[ simplifier.mIndices[ t * 3 + c ] ] );
+			}
+		}
 	}
-			
-	TriMesh mesh = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
-		
-	indices.clear();
-	normals.clear();
-	positions.clear();
-	srcNormals.clear();
-	srcPositions.clear();
-	srcTexCoords.clear();
-	texCoords.clear();
+	indices.swap( simplified );
+	optimizeVertexFetch( mesh );
 
-	return mesh;
+	return (float)math<double>::sqrt( error );
 }
 
-TriMesh MeshHelper::createRingTriMesh( uint32_t segments, float secondRadius )
+namespace
 {
-	vector<uint32_t> indices;
-	vector<Vec3f> normals;
-	vector<Vec3f> positions;
-	vector<Vec2f> texCoords;
 
-	Vec3f norm0( 0.0f, 0.0f, 1.0f );
+// Normalizes count vectors in place, leaving those without length alone
+void normalizeVectors( Vec3f *v, size_t count )
+{
+	size_t i = 0;
+	if ( useSimd() ) {
+#if defined( MESHHELPER_SSE )
+		for ( ; i + 4 <= count; i += 4 ) {
+			const Vec3f *n = v + i;
+			storeNormalized4( &v[ i ].x, _mm_set_ps( n[ 3 ].x, n[ 2 ].x, n[ 1 ].x, n[ 0 ].x ), 
+				_mm_set_ps( n[ 3 ].y, n[ 2 ].y, n[ 1 ].y, n[ 0 ].y ), _mm_set_ps( n[ 3 ].z, n[ 2 ].z, n[ 1 ].z, n[ 0 ].z ) );
+		}
+#elif defined( MESHHELPER_NEON )
+		for ( ; i + 4 <= count; i += 4 ) {
+			storeNormalized4( &v[ i ].x, vld3q_f32( &v[ i ].x ) );
+		}
+#endif
+	}
+	for ( ; i < count; ++i ) {
+		v[ i ] = normalizeOrKeep( v[ i ] );
+	}
+}
+
+// Angle whose sine and cosine are proportional to the arguments, for a 
+// non-negative sine. The arctangent of the smaller ratio of the two comes 
+// from Abramowitz and Stegun's polynomial 4.4.49, to within 2e-8 radians.
+inline float angleOf( float sine, float cosine )
+{
+	float absCosine	= math<float>::abs( cosine );
+	float ratio		= std::min( sine, absCosine ) / std::max( std::max( sine, absCosine ), FLT_MIN );
+	float square	= ratio * ratio;
+	float angle		= ratio * ( 0.9999993329f + square * ( -0.3332985605f + square * ( 0.1994653599f + 
+		square * ( -0.1390853351f + square * ( 0.0964200441f + square * ( -0.0559098861f + 
+		square * ( 0.0218612288f - square * 0.0040540580f ) ) ) ) ) ) );
+	if ( sine > absCosine ) {
+		angle = (float)M_PI * 0.5f - angle;
+	}
+	return cosine < 0.0f ? (float)M_PI - angle : angle;
+}
+
+// Adds the face normal of each of triangles [ begin, end ) to the normals 
+// of its corners in dst, weighted by area or by the angle at each corner
+void accumulateNormals( const uint32_t *indices, const Vec3f *positions, size_t begin, size_t end, 
+	MeshHelper::NormalWeight weight, Vec3f *dst )
+{
+	for ( size_t t = begin; t < end; ++t ) {
+		const uint32_t *corners = indices + t * 3;
+		const Vec3f &a	= positions[ corners[ 0 ] ];
+		const Vec3f &b	= positions[ corners[ 1 ] ];
+		const Vec3f &c	= positions[ corners[ 2 ] ];
+		Vec3f ab		= b - a;
+		Vec3f bc		= c - b;
+		Vec3f ca		= a - c;
 
-	float delta = ( (float)M_PI * 2.0f ) / (float)segments;
-	float theta = delta;
-	for ( uint32_t i = 0; i < segments; ++i, theta += delta ) {
+		// The cross product is as long as twice the area
+		Vec3f normal = ab.cross( -ca );
+		if ( weight == MeshHelper::NORMAL_WEIGHT_AREA ) {
+			dst[ corners[ 0 ] ] += normal;
+			dst[ corners[ 1 ] ] += normal;
+			dst[ corners[ 2 ] ] += normal;
+			continue;
+		}
 
-		Vec3f vert0( math<float>::cos( theta ), math<float>::sin( theta ), 0.0f );
-		Vec3f vert1( math<float>::cos( theta + delta ), math<float>::sin( theta + delta ), 0.0f );
-		Vec3f vert2 = vert0 * secondRadius;
-		Vec3f vert3 = vert1 * secondRadius;
-		if ( i >= segments - 1 ) {
-			vert1.x = math<float>::cos( delta );
-			vert1.y = math<float>::sin( delta ); 
-			vert3	= vert1 * secondRadius;
+		// The length is each corner's sine times the lengths of its edges, 
+		// and their dot product is its cosine times the same
+		float length = normal.length();
+		if ( length <= 0.0f ) {
+			continue;
 		}
+		normal /= length;
+		dst[ corners[ 0 ] ] += normal * angleOf( length, -ab.dot( ca ) );
+		dst[ corners[ 1 ] ] += normal * angleOf( length, -bc.dot( ab ) );
+		dst[ corners[ 2 ] ] += normal * angleOf( length, -ca.dot( bc ) );
+	}
+}
 
-		Vec2f texCoord0 = ( vert0.xy() + Vec2f::one() ) * 0.5f;
-		Vec2f texCoord1 = ( vert1.xy() + Vec2f::one() ) * 0.5f;
-		Vec2f texCoord2 = ( vert2.xy() + Vec2f::one() ) * 0.5f;
-		Vec2f texCoord3 = ( vert3.xy() + Vec2f::one() ) * 0.5f;
+// Sums slices of triangles into the normals for calcNormals(). The first 
+// slice sums straight into the normals, and each of the rest into its own buffer.
+struct NormalSliceJob
+{
+	const uint32_t				*mIndices;
+	const Vec3f					*mPositions;
+	size_t						mNumTriangles;
+	size_t						mNumVertices;
+	size_t						mNumSlices;
+	MeshHelper::NormalWeight	mWeight;
+	Vec3f						*mNormals;
+	vector<vector<Vec3f> >		*mBuffers;
 
-		positions.push_back( vert0 );
-		positions.push_back( vert2 );
-		positions.push_back( vert1 );
-		positions.push_back( vert1 );
-		positions.push_back( vert2 );
-		positions.push_back( vert3 );
+	void operator()( size_t begin, size_t end )
+	{
+		for ( size_t s = begin; s < end; ++s ) {
+			Vec3f *dst = mNormals;
+			if ( s > 0 ) {
+				vector<Vec3f> &buffer = ( *mBuffers )[ s - 1 ];
+				buffer.assign( mNumVertices, Vec3f::zero() );
+				dst = &buffer[ 0 ];
+			}
+			accumulateNormals( mIndices, mPositions, mNumTriangles * s / mNumSlices, 
+				mNumTriangles * ( s + 1 ) / mNumSlices, mWeight, dst );
+		}
+	}
+};
 
-		texCoords.push_back( texCoord0 );
-		texCoords.push_back( texCoord2 );
-		texCoords.push_back( texCoord1 );
-		texCoords.push_back( texCoord1 );
-		texCoords.push_back( texCoord2 );
-		texCoords.push_back( texCoord3 );
+// Adds the slice buffers into a range of normals, in slice order, and normalizes them
+struct NormalReduceJob
+{
+	Vec3f						*mNormals;
+	const vector<vector<Vec3f> >	*mBuffers;
 
-		for ( uint32_t j = 0; j < 6; ++j ) {
-			indices.push_back( i * 6 + j );
-			normals.push_back( norm0 );
+	void operator()( size_t begin, size_t end )
+	{
+		for ( vector<vector<Vec3f> >::const_iterator iter = mBuffers->begin(); iter != mBuffers->end(); ++iter ) {
+			const Vec3f *src = &( *iter )[ 0 ];
+			for ( size_t v = begin; v < end; ++v ) {
+				mNormals[ v ] += src[ v ];
+			}
 		}
+		normalizeVectors( mNormals + begin, end - begin );
+	}
+};
+
+}
+
+void MeshHelper::calcNormals( const vector<uint32_t> &indices, const vector<Vec3f> &positions, vector<Vec3f> &normals, 
+	NormalWeight weight, uint32_t numThreads )
+{
+	static const size_t kMinTrianglesPerSlice	= 65536;
+	static const size_t kMinVerticesPerBand		= 16384;
 
+	size_t numTriangles	= indices.size() / 3;
+	size_t numVertices	= positions.size();
+	normals.assign( numVertices, Vec3f::zero() );
+	if ( numTriangles == 0 || numVertices == 0 ) {
+		return;
 	}
 
-	TriMesh mesh = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
+	// Triangles are split into a slice per thread, each summing into its own 
+	// normals, so no two threads ever add to the same one. Slices only depend 
+	// on the thread count, so results are repeatable for a given count.
+	numThreads			= getNumThreads( numThreads );
+	size_t numSlices	= std::min<size_t>( numThreads, std::max<size_t>( numTriangles / kMinTrianglesPerSlice, 1 ) );
+	vector<vector<Vec3f> > buffers( numSlices - 1 );
 
-	indices.clear();
-	normals.clear();
-	positions.clear();
-	texCoords.clear();
+	NormalSliceJob sliceJob;
+	sliceJob.mIndices		= &indices[ 0 ];
+	sliceJob.mPositions		= &positions[ 0 ];
+	sliceJob.mNumTriangles	= numTriangles;
+	sliceJob.mNumVertices	= numVertices;
+	sliceJob.mNumSlices		= numSlices;
+	sliceJob.mWeight		= weight;
+	sliceJob.mNormals		= &normals[ 0 ];
+	sliceJob.mBuffers		= &buffers;
+	parallelFor( numSlices, 1, numThreads, sliceJob );
 
-	return mesh;
+	NormalReduceJob reduceJob;
+	reduceJob.mNormals	= &normals[ 0 ];
+	reduceJob.mBuffers	= &buffers;
+	size_t grain		= std::max<size_t>( kMinVerticesPerBand, numVertices / ( numThreads * 4 ) );
+	parallelFor( numVertices, grain, numThreads, reduceJob );
 }
 
-TriMesh MeshHelper::createSphereTriMesh( uint32_t segments )
+void MeshHelper::calcNormals( TriMesh &mesh, NormalWeight weight, uint32_t numThreads )
 {
-	vector<uint32_t> indices;
-	vector<Vec3f> normals;
-	vector<Vec3f> positions;
-	vector<Vec2f> texCoords;
+	calcNormals( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), weight, numThreads );
+}
 
-	uint32_t layers = segments / 2;
-	float step = (float)M_PI / (float)layers;
-	float delta = ((float)M_PI * 2.0f) / (float)segments;
+namespace
+{
 
-	uint32_t p = 0;
-	for ( float phi = 0.0f; p <= layers; p++, phi += step ) {
-		uint32_t t = 0;
-		for ( float theta = delta; t < segments; t++, theta += delta ) {
-			float sinP = math<float>::sin( phi );
-			Vec3f position(
-				sinP * math<float>::cos( theta ),
-				sinP * math<float>::sin( theta ),
-				-math<float>::cos( phi ) );
-			positions.push_back(position);
+// Sums slices of triangles into the texture coordinate directions 
+// of their corners for calcTangents(), each into its own buffer
+struct TangentSliceJob
+{
+	const uint32_t			*mIndices;
+	const Vec3f				*mPositions;
+	const Vec2f				*mTexCoords;
+	size_t					mNumTriangles;
+	size_t					mNumVertices;
+	size_t					mNumSlices;
+	vector<vector<Vec3f> >	*mBuffers;
 
-			Vec3f normal = position.normalized();
-			normals.push_back( normal );
+	void operator()( size_t begin, size_t end )
+	{
+		for ( size_t s = begin; s < end; ++s ) {
+			vector<Vec3f> &buffer = ( *mBuffers )[ s ];
+			buffer.assign( mNumVertices * 2, Vec3f::zero() );
+			size_t last = mNumTriangles * ( s + 1 ) / mNumSlices;
+			for ( size_t t = mNumTriangles * s / mNumSlices; t < last; ++t ) {
+				const uint32_t *corners = mIndices + t * 3;
+				addTexCoordDirections( corners[ 0 ], corners[ 1 ], corners[ 2 ], mPositions, mTexCoords, &buffer[ 0 ] );
+			}
+		}
+	}
+};
 
-			texCoords.push_back( ( normal.xy() + Vec2f::one() ) * 0.5f ); 
+// Adds up the slice buffers for a range of vertices, in slice order, and turns them into tangents
+struct TangentReduceJob
+{
+	const Vec3f						*mNormals;
+	const vector<vector<Vec3f> >	*mBuffers;
+	Vec4f							*mTangents;
 
-			uint32_t n = t + 1 >= segments ? 0 : t + 1;
-			indices.push_back( p * segments + t );
-			indices.push_back( ( p + 1 ) * segments + t );
-			indices.push_back( p * segments + n );
-			indices.push_back( p * segments + n );
-			indices.push_back( ( p + 1 ) * segments + t );
-			indices.push_back( ( p + 1 ) * segments + n );
+	void operator()( size_t begin, size_t end )
+	{
+		for ( size_t v = begin; v < end; ++v ) {
+			Vec3f u		= ( *mBuffers )[ 0 ][ v * 2 ];
+			Vec3f dir	= ( *mBuffers )[ 0 ][ v * 2 + 1 ];
+			for ( size_t s = 1; s < mBuffers->size(); ++s ) {
+				u	+= ( *mBuffers )[ s ][ v * 2 ];
+				dir	+= ( *mBuffers )[ s ][ v * 2 + 1 ];
+			}
+			mTangents[ v ] = finishTangent( mNormals[ v ], u, dir );
 		}
 	}
+};
 
-	for ( vector<uint32_t>::iterator iter = indices.begin(); iter != indices.end(); ) {
-		if ( *iter < positions.size() ) {
-			++iter;
-		} else {
-			iter = indices.erase( iter );
-		}
+}
+
+void MeshHelper::calcTangents( const vector<uint32_t> &indices, const vector<Vec3f> &positions, 
+	const vector<Vec3f> &normals, const vector<Vec2f> &texCoords, vector<Vec4f> &tangents, uint32_t numThreads )
+{
+	static const size_t kMinTrianglesPerSlice	= 65536;
+	static const size_t kMinVerticesPerBand		= 16384;
+
+	size_t numTriangles	= indices.size() / 3;
+	size_t numVertices	= positions.size();
+	tangents.clear();
+	if ( numVertices == 0 || normals.size() != numVertices || texCoords.size() != numVertices ) {
+		return;
 	}
+	tangents.resize( numVertices );
 
-	TriMesh mesh = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
+	// Slices are summed as for calcNormals()
+	numThreads			= getNumThreads( numThreads );
+	size_t numSlices	= std::min<size_t>( numThreads, std::max<size_t>( numTriangles / kMinTrianglesPerSlice, 1 ) );
+	vector<vector<Vec3f> > buffers( numSlices );
 
-	indices.clear();
-	normals.clear();
-	positions.clear();
-	texCoords.clear();
+	TangentSliceJob sliceJob;
+	sliceJob.mIndices		= indices.empty() ? 0 : &indices[ 0 ];
+	sliceJob.mPositions		= &positions[ 0 ];
+	sliceJob.mTexCoords		= &texCoords[ 0 ];
+	sliceJob.mNumTriangles	= numTriangles;
+	sliceJob.mNumVertices	= numVertices;
+	sliceJob.mNumSlices		= numSlices;
+	sliceJob.mBuffers		= &buffers;
+	parallelFor( numSlices, 1, numThreads, sliceJob );
 
-	return mesh;
+	TangentReduceJob reduceJob;
+	reduceJob.mNormals	= &normals[ 0 ];
+	reduceJob.mBuffers	= &buffers;
+	reduceJob.mTangents	= &tangents[ 0 ];
+	size_t grain		= std::max<size_t>( kMinVerticesPerBand, numVertices / ( numThreads * 4 ) );
+	parallelFor( numVertices, grain, numThreads, reduceJob );
 }
 
-TriMesh MeshHelper::createPlaneTriMesh( uint32_t hSegments, uint32_t vSegments )
+void MeshHelper::calcTangents( const TriMesh &mesh, vector<Vec4f> &tangents, uint32_t numThreads )
 {
-	vector<uint32_t> indices;
-	vector<Vec3f> normals;
-	vector<Vec3f> positions;
-	vector<Vec2f> texCoords;
-	
-	Vec3f norm0( 0.0f, 0.0f, 1.0f );
-	double xStep = 1.0 / (hSegments-1);
-	double yStep = 1.0 / (vSegments-1);
-	
-	
-	for (uint32_t y = 0; y < vSegments; y++)
-	{
-		for (uint32_t x = 0; x < hSegments; x++)
-		{
-			double xRat = xStep * x;
-			double yRat = yStep * y;
-			
-			positions.push_back(Vec3f( xRat - .5f, yRat - .5f, 0.0f ));
-			texCoords.push_back(Vec2f(xRat, yRat));
-			normals.push_back( norm0 );
+	calcTangents( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords(), tangents, numThreads );
+}
+
+#if ! defined( CINDER_COCOA_TOUCH )
+
+gl::VboMesh MeshHelper::createVboMesh( const StagingBuffer &buffer )
+{
+	GLenum primitiveType = buffer.getTopology() == TOPOLOGY_TRIANGLES ? GL_TRIANGLES : GL_TRIANGLE_STRIP;
+
+	// gl::VboMesh only draws 32-bit indices
+	vector<uint32_t> widened;
+	const void *indices = buffer.getIndexData();
+	if ( buffer.getIndexFormat() == INDEX_UINT16 ) {
+		bool restart = buffer.getTopology() == TOPOLOGY_STRIP_RESTART;
+		widened.resize( buffer.getNumIndices() );
+		for ( size_t i = 0; i < widened.size(); i++ ) {
+			uint32_t index	= buffer.getIndex( i );
+			widened[ i ]	= restart && index == 0xffff ? 0xffffffff : index;
 		}
+		indices = widened.empty() ? 0 : &widened[ 0 ];
 	}
-	
-	for (uint32_t y = 0; y < vSegments-1; y++)
-	{
-		for (uint32_t x = 0; x < hSegments-1; x++)
-		{
-			int index0 = ( y * hSegments ) + x;
-			int index1 = index0 + 1;
-			int index2 = ( ( y + 1 ) * hSegments ) + x;
-			int index3 = index2 + 1;
-			
-			indices.push_back(index0);
-			indices.push_back(index1);
-			indices.push_back(index2);
-			
-			indices.push_back(index2);
-			indices.push_back(index1);
-			indices.push_back(index3);
+
+	const VertexLayout &layout = buffer.getLayout();
+	bool packed = layout == VertexLayout::interleaved();
+	if ( layout.isCompressed() || ( layout.isInterleaved() && !packed ) ) {
+		TriMesh mesh = createTriMesh( buffer );
+		if ( buffer.getTopology() == TOPOLOGY_TRIANGLES ) {
+			return createVboMesh( mesh, primitiveType );
 		}
+		// Keep the strips rather than the triangles they were expanded into
+		const uint32_t *begin = reinterpret_cast<const uint32_t*>( indices );
+		return createVboMesh( vector<uint32_t>( begin, begin + buffer.getNumIndices() ), mesh.getVertices(), 
+			mesh.getNormals(), mesh.getTexCoords(), primitiveType );
 	}
-	
-	TriMesh mesh = MeshHelper::createTriMesh( indices, positions, normals, texCoords );
 
-	indices.clear();
-	normals.clear();
-	positions.clear();
-	texCoords.clear();
+	ci::gl::VboMesh::Layout vboLayout;
+	if ( buffer.getNumIndices() > 0 ) {
+		vboLayout.setStaticIndices();
+	}
+	vboLayout.setStaticPositions();
+	vboLayout.setStaticNormals();
+	vboLayout.setStaticTexCoords2d();
+
+	if ( packed ) {
+		// VboMesh lays out a static buffer it is handed as interleaved 
+		// position, normal and texture coordinate records
+		gl::Vbo indexVbo( GL_ELEMENT_ARRAY_BUFFER );
+		if ( buffer.getNumIndices() > 0 ) {
+			indexVbo.bufferData( buffer.getNumIndices() * sizeof( uint32_t ), indices, GL_STATIC_DRAW );
+		}
+		gl::Vbo staticVbo( GL_ARRAY_BUFFER );
+		staticVbo.bufferData( buffer.getVertexDataSize(), buffer.getVertexData(), GL_STATIC_DRAW );
+		return gl::VboMesh( buffer.getNumVertices(), buffer.getNumIndices(), vboLayout, primitiveType, 
+			buffer.getNumIndices() > 0 ? &indexVbo : 0, &staticVbo, 0 );
+	}
 
-	return mesh;
+	// The static buffer is allocated planar, in the order the staging buffer 
+	// is laid out, so each buffer is filled with a single upload
+	gl::VboMesh mesh( buffer.getNumVertices(), buffer.getNumIndices(), vboLayout, primitiveType );
+	if ( buffer.getNumIndices() > 0 ) {
+		mesh.getIndexVbo().bufferSubData( 0, buffer.getNumIndices() * sizeof( uint32_t ), indices );
+	}
+	if ( buffer.getVertexDataSize() > 0 ) {
+		mesh.getStaticVbo().bufferSubData( 0, buffer.getVertexDataSize(), buffer.getVertexData() );
+	}
 
+	return mesh;
 }
 
-#if ! defined( CINDER_COCOA_TOUCH )
+gl::VboMesh MeshHelper::createVboMesh( const TriMesh &mesh, GLenum primitiveType )
+{
+	return createVboMesh( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords(), primitiveType );
+}
 
 gl::VboMesh MeshHelper::createVboMesh( const vector<uint32_t> &indices, const vector<Vec3f> &positions, 
 	const vector<Vec3f> &normals, const vector<Vec2f> &texCoords, GLenum primitiveType )
@@ -728,44 +5372,51 @@ gl::VboMesh MeshHelper::createVboMesh( const vector<uint32_t> &indices, const ve
 
 gl::VboMesh MeshHelper::createCircleVboMesh( uint32_t segments )
 {
-	TriMesh mesh = createCircleTriMesh( segments );
-	return createVboMesh( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords() );
+	return createVboMesh( createStagingBuffer( Primitive::circle( segments ), VertexLayout(), INDEX_UINT32 ) );
 }
 
-gl::VboMesh MeshHelper::createConeVboMesh( uint32_t segments, bool closeBase )
+gl::VboMesh MeshHelper::createConeVboMesh( uint32_t segments, bool closeBase, uint32_t layers )
 {
-	TriMesh mesh = createConeTriMesh( segments, closeBase );
-	return createVboMesh( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords() );
+	return createVboMesh( createStagingBuffer( Primitive::cone( segments, closeBase, layers ), VertexLayout(), INDEX_UINT32 ) );
 }
 
-gl::VboMesh MeshHelper::createCubeVboMesh()
+gl::VboMesh MeshHelper::createCubeVboMesh( uint32_t subdivisions )
 {
-	TriMesh mesh = createCubeTriMesh();
-	return createVboMesh( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords() );
+	return createVboMesh( createStagingBuffer( Primitive::cube( subdivisions ), VertexLayout(), INDEX_UINT32 ) );
 }
 
-gl::VboMesh MeshHelper::createCylinderVboMesh( uint32_t segments, float topRadius, float baseRadius, bool closeTop, bool closeBase )
+gl::VboMesh MeshHelper::createCylinderVboMesh( uint32_t segments, float topRadius, float baseRadius, bool closeTop, bool closeBase, 
+	uint32_t layers )
 {
-	TriMesh mesh = createCylinderTriMesh( segments, topRadius, baseRadius, closeTop, closeBase );
-	return createVboMesh( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords() );
+	return createVboMesh( createStagingBuffer( Primitive::cylinder( segments, topRadius, baseRadius, closeTop, closeBase, layers ), 
+		VertexLayout(), INDEX_UINT32 ) );
 }
 
 gl::VboMesh MeshHelper::createRingVboMesh( uint32_t segments, float secondRadius )
 {
-	TriMesh mesh = createRingTriMesh( segments, secondRadius );
-	return createVboMesh( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords() );
+	return createVboMesh( createStagingBuffer( Primitive::ring( segments, secondRadius ), VertexLayout(), INDEX_UINT32 ) );
 }
 
-gl::VboMesh MeshHelper::createSphereVboMesh( uint32_t segments )
+gl::VboMesh MeshHelper::createSphereVboMesh( uint32_t segments, uint32_t rings )
 {
-	TriMesh mesh = createSphereTriMesh( segments );
-	return createVboMesh( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords() );
+	return createVboMesh( createStagingBuffer( Primitive::sphere( segments, rings ), VertexLayout(), INDEX_UINT32 ) );
 }
 
 gl::VboMesh MeshHelper::createPlaneVboMesh( uint32_t hSegments, uint32_t vSegments)
 {
-	TriMesh mesh = createPlaneTriMesh( hSegments, vSegments );
-	return createVboMesh( mesh.getIndices(), mesh.getVertices(), mesh.getNormals(), mesh.getTexCoords() );
+	return createVboMesh( createStagingBuffer( Primitive::plane( hSegments, vSegments ), VertexLayout(), INDEX_UINT32 ) );
+}
+
+gl::VboMesh MeshHelper::createIcosphereVboMesh( uint32_t subdivisions )
+{
+	return createVboMesh( createStagingBuffer( Primitive::icosphere( subdivisions ), VertexLayout(), INDEX_UINT32 ) );
+}
+
+gl::VboMesh MeshHelper::createTorusVboMesh( uint32_t majorSegments, uint32_t minorSegments, float majorRadius, 
+	float minorRadius )
+{
+	return createVboMesh( createStagingBuffer( Primitive::torus( majorSegments, minorSegments, majorRadius, minorRadius ), 
+		VertexLayout(), INDEX_UINT32 ) );
 }
 
 #endif
@@ -1,97 +1,635 @@
-/*
-* Copyright (c) 2012, Ban the Rewind
-* All rights reserved.
-* 
-* Redistribution and use in source and binary forms, with or 
-* without modification, are permitted provided that the following 
-* conditions are met:
-* 
-* Redistributions of source code must retain the above copyright 
-* notice, this list of conditions and the following disclaimer.
-* Redistributions in binary form must reproduce the above copyright 
-* notice, this list of conditions and the following disclaimer in 
-* the documentation and/or other materials provided with the 
-* distribution.
-* 
-* Neither the name of the Ban the Rewind nor the names of its 
-* contributors may be used to endorse or promote products 
-* derived from this software without specific prior written 
-* permission.
-* 
-* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
-* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
-* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
-* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
-* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
-* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
-* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
-* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
-* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
-* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
-* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
-* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
-* 
-*/
-
-#pragma once
-
-#if ! defined( CINDER_COCOA_TOUCH )
-	#include "cinder/gl/Vbo.h"
-#endif
-#include "cinder/TriMesh.h"
-#include <map>
-
-class MeshHelper 
-{
-public:
-	//! Create TriMesh from vectors of vertex data.
-	static ci::TriMesh		createTriMesh( std::vector<uint32_t> &indices, const std::vector<ci::Vec3f> &positions,
-								const std::vector<ci::Vec3f> &normals, const std::vector<ci::Vec2f> &texCoords );
-
-	//! Create circle TriMesh with a radius of 1.0 and \a segments.
-	static ci::TriMesh		createCircleTriMesh( uint32_t segments = 12 );
-	/*! Create cone TriMesh with a radius and height of 1.0 and \a segments. 
-		Base is closed when \a closeBase is set to true. */
-	static ci::TriMesh		createConeTriMesh( uint32_t segments = 12, bool closeBase = true );
-	//! Create cube TriMesh with an edge length of 1.0
-	static ci::TriMesh		createCubeTriMesh();
-	/*! Create cylinder TriMesh with a height of 1.0, top radius of \a topRadius, base radius 
-		of \a baseRadius and \a segments. Top and base are closed with \a closeTop and 
-		\a closeBase flags. */
-	static ci::TriMesh		createCylinderTriMesh( uint32_t segments = 12, float topRadius = 1.0f, 
-		float baseRadius = 1.0f, bool closeTop = true, bool closeBase = true );
-	/*! Create ring TriMesh with a radius of 1.0, \a segments, and second radius 
-	 of \a v. */
-	static ci::TriMesh		createRingTriMesh( uint32_t segments = 12, float secondRadius = 0.5f );
-	//! Create sphere TriMesh with a radius of 1.0 and \a segments.
-	static ci::TriMesh		createSphereTriMesh( uint32_t segments );
-	//! Create square TriMesh with an edge length of 1.0.
-	static ci::TriMesh		createPlaneTriMesh( uint32_t hSegments = 2, uint32_t vSegments = 2 );
-
-#if ! defined( CINDER_COCOA_TOUCH )
-	//! Create VboMesh from vectors of vertex data.
-	static ci::gl::VboMesh	createVboMesh( const std::vector<uint32_t> &indices, const std::vector<ci::Vec3f> &positions, 
-								const std::vector<ci::Vec3f> &normals, const std::vector<ci::Vec2f> &texCoords, 
-								GLenum primitiveType = GL_TRIANGLES );
-	
-	//! Create circle VboMesh with a radius of 1.0 and \a segments.
-	static ci::gl::VboMesh	createCircleVboMesh( uint32_t segments = 12 );
-	/*! Create cone VboMesh with a radius and height of 1.0 and \a segments. 
-		Base is closed when \a closeBase is set to true. */
-	static ci::gl::VboMesh	createConeVboMesh( uint32_t segments = 12, bool closeBase = true );
-	//! Create cube VboMesh with an edge length of 1.0
-	static ci::gl::VboMesh	createCubeVboMesh();
-	/*! Create cylinder VboMesh with a height of 1.0, top radius of \a topRadius, base radius 
-		of \a baseRadius and \a segments. Top and base are closed with \a closeTop and 
-		\a closeBase flags. */
-	static ci::gl::VboMesh	createCylinderVboMesh( uint32_t segments = 12, float topRadius = 1.0f, 
-		float baseRadius = 1.0f, bool closeTop = true, bool closeBase = true );
-	/*! Create ring VboMesh with a radius of 1.0, \a segments, and a second radius .
-	 of \a secondRadius. */
-	static ci::gl::VboMesh	createRingVboMesh( uint32_t segments = 12, float secondRadius = 0.5f );
-	//! Create sphere VboMesh with a radius of 1.0 and \a segments.
-	static ci::gl::VboMesh	createSphereVboMesh( uint32_t segments = 12 );
-	//! Create square VboMesh with an edge length of 1.0.
-	static ci::gl::VboMesh	createPlaneVboMesh( uint32_t hSegments = 2, uint32_t vSegments = 2 );
-#endif
-};
+/*
+* Copyright (c) 2012, Ban the Rewind
+* All rights reserved.
+* 
+* Redistribution and use in source and binary forms, with or 
+* without modification, are permitted provided that the following 
+* conditions are met:
+* 
+* Redistributions of source code must retain the above copyright 
+* notice, this list of conditions and the following disclaimer.
+* Redistributions in binary form must reproduce the above copyright 
+* notice, this list of conditions and the following disclaimer in 
+* the documentation and/or other materials provided with the 
+* distribution.
+* 
+* Neither the name of the Ban the Rewind nor the names of its 
+* contributors may be used to endorse or promote products 
+* derived from this software without specific prior written 
+* permission.
+* 
+* THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS 
+* "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT 
+* LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS 
+* FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE 
+* COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, 
+* INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+* BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; 
+* LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER 
+* CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, 
+* STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) 
+* ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF 
+* ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+* 
+*/
+
+#pragma once
+
+#if ! defined( CINDER_COCOA_TOUCH )
+	#include "cinder/gl/Vbo.h"
+#endif
+#include "cinder/AxisAlignedBox.h"
+#include "cinder/Matrix.h"
+#include "cinder/TriMesh.h"
+#include <cfloat>
+#include <map>
+
+class MeshHelper 
+{
+public:
+	//! Primitive types understood by the generator core.
+	typedef enum
+	{
+		PRIMITIVE_CIRCLE, 
+		PRIMITIVE_CONE, 
+		PRIMITIVE_CUBE, 
+		PRIMITIVE_CYLINDER, 
+		PRIMITIVE_RING, 
+		PRIMITIVE_SPHERE, 
+		PRIMITIVE_PLANE, 
+		PRIMITIVE_ICOSPHERE, 
+		PRIMITIVE_TORUS
+	} PrimitiveType;
+
+	/*! Parameter set describing a primitive. Use the static constructors, 
+		which take the same arguments as the matching create*TriMesh method. */
+	class Primitive
+	{
+	public:
+		Primitive( PrimitiveType type = PRIMITIVE_CUBE );
+
+		static Primitive	circle( uint32_t segments = 12 );
+		static Primitive	cone( uint32_t segments = 12, bool closeBase = true, uint32_t layers = 1 );
+		static Primitive	cube( uint32_t subdivisions = 1 );
+		static Primitive	cylinder( uint32_t segments = 12, float topRadius = 1.0f, 
+			float baseRadius = 1.0f, bool closeTop = true, bool closeBase = true, uint32_t layers = 1 );
+		static Primitive	ring( uint32_t segments = 12, float secondRadius = 0.5f );
+		static Primitive	sphere( uint32_t segments = 12, uint32_t rings = 0 );
+		static Primitive	plane( uint32_t hSegments = 2, uint32_t vSegments = 2 );
+		static Primitive	icosphere( uint32_t subdivisions = 2 );
+		static Primitive	torus( uint32_t majorSegments = 24, uint32_t minorSegments = 12, 
+			float majorRadius = 1.0f, float minorRadius = 0.25f );
+
+		PrimitiveType		getType() const { return mType; }
+		/*! Segment count around the axis. Horizontal vertex count for planes. 
+			Subdivision level for icospheres. */
+		uint32_t			getSegments() const { return mSegments; }
+		/*! Ring count from pole to pole for spheres. Vertical vertex count for planes. 
+			Segment count around the tube for tori. */
+		uint32_t			getRings() const { return mRings; }
+		//! Band count up the side of cones and cylinders. Quads along each edge for cubes.
+		uint32_t			getLayers() const { return mLayers; }
+		//! Top radius of cylinders. Radius of the middle of the tube for tori.
+		float				getTopRadius() const { return mTopRadius; }
+		float				getBaseRadius() const { return mBaseRadius; }
+		//! Inner radius of rings. Radius of the tube for tori.
+		float				getSecondRadius() const { return mSecondRadius; }
+		bool				getCloseTop() const { return mCloseTop; }
+		bool				getCloseBase() const { return mCloseBase; }
+
+		//! Strict weak ordering over every parameter, for ordered containers.
+		bool				operator<( const Primitive &rhs ) const;
+		bool				operator==( const Primitive &rhs ) const;
+		bool				operator!=( const Primitive &rhs ) const { return !( *this == rhs ); }
+	private:
+		PrimitiveType		mType;
+		uint32_t			mSegments;
+		uint32_t			mRings;
+		uint32_t			mLayers;
+		float				mTopRadius;
+		float				mBaseRadius;
+		float				mSecondRadius;
+		bool				mCloseTop;
+		bool				mCloseBase;
+	};
+
+	/*! Enables or disables the SSE, AVX and NEON vertex kernels at runtime. On 
+		x86, AVX or SSE2 is chosen at startup by what the CPU supports. Scalar 
+		code is used when disabled, when the CPU has neither, when built without 
+		SIMD support, or with MESHHELPER_NO_SIMD defined. Output is identical 
+		either way. */
+	static void				setSimdEnabled( bool enabled = true );
+	static bool				isSimdEnabled();
+
+	//! Index arrangements the generators can write.
+	typedef enum
+	{
+		//! Independent triangles, three indices each.
+		TOPOLOGY_TRIANGLES, 
+		/*! Triangle strips separated by a primitive restart index of all ones, 
+			0xffff or 0xffffffff depending on index width. Enable GL_PRIMITIVE_RESTART 
+			with that index when drawing. */
+		TOPOLOGY_STRIP_RESTART, 
+		//! A single triangle strip, with strips stitched together by degenerate triangles.
+		TOPOLOGY_STRIP_DEGENERATE
+	} Topology;
+
+	/*! Calculates the exact vertex and index counts \a primitive will generate 
+		as \a topology. */
+	static void				calcSize( const Primitive &primitive, size_t *numVertices, size_t *numIndices, 
+									Topology topology = TOPOLOGY_TRIANGLES );
+	//! Calculates a box enclosing every position \a primitive will generate.
+	static ci::AxisAlignedBox3f	calcBounds( const Primitive &primitive );
+	/*! Describes how vertex attributes are arranged in memory. The default is 
+		planar: every position, then every normal, then every texture coordinate, 
+		as in a static gl::VboMesh. Interleaved layouts store one record per 
+		vertex, with the attributes in a chosen order. */
+	class VertexLayout
+	{
+	public:
+		typedef enum
+		{
+			ATTRIB_POSITION, 
+			ATTRIB_NORMAL, 
+			ATTRIB_TEX_COORD
+		} Attrib;
+
+		//! Storage formats for attributes. Compressed formats are encoded from full precision.
+		typedef enum
+		{
+			//! 32-bit floats. Default for every attribute.
+			FORMAT_FLOAT, 
+			//! 16-bit floats.
+			FORMAT_HALF, 
+			/*! 16-bit unsigned normalized integers. Positions are quantized to the 
+				bounds of the primitive, as given by calcBounds(). Texture coordinates 
+				are clamped to [ 0, 1 ]. Not available for normals. */
+			FORMAT_UNORM16, 
+			/*! Normals only. Octahedral encoding as two 16-bit signed normalized 
+				integers, in 32 bits. */
+			FORMAT_OCTAHEDRAL
+		} Format;
+
+		VertexLayout();
+
+		/*! Interleaved layout with records holding \a first, \a second and \a third, 
+			which must differ, in that order. Records are \a stride bytes apart, or 
+			tightly packed when zero, rounded up to a multiple of \a alignment so 
+			each starts on an \a alignment boundary from the start of the data. */
+		static VertexLayout	interleaved( Attrib first = ATTRIB_POSITION, Attrib second = ATTRIB_NORMAL, 
+			Attrib third = ATTRIB_TEX_COORD, size_t stride = 0, size_t alignment = 4 );
+
+		/*! Stores \a attrib in \a format, falling back to FORMAT_FLOAT if \a attrib 
+			doesn't support it. Each attribute starts on a four byte boundary. */
+		void				setFormat( Attrib attrib, Format format );
+		Format				getFormat( Attrib attrib ) const { return mFormats[ attrib ]; }
+		//! True when any attribute uses a format other than FORMAT_FLOAT.
+		bool				isCompressed() const;
+
+		bool				isInterleaved() const { return mInterleaved; }
+		//! Size in bytes of a single \a attrib.
+		size_t				getSize( Attrib attrib ) const;
+		//! Byte offset of the first \a attrib in vertex data holding \a numVertices.
+		size_t				getOffset( Attrib attrib, size_t numVertices ) const;
+		//! Distance in bytes between consecutive values of \a attrib.
+		size_t				getStride( Attrib attrib ) const;
+		//! Size in bytes of vertex data holding \a numVertices.
+		size_t				getDataSize( size_t numVertices ) const;
+
+		bool				operator==( const VertexLayout &rhs ) const;
+		bool				operator!=( const VertexLayout &rhs ) const { return !( *this == rhs ); }
+	private:
+		//! Lays out the record from the order and formats.
+		void				update();
+
+		bool				mInterleaved;
+		Attrib				mOrder[ 3 ];
+		Format				mFormats[ 3 ];
+		size_t				mMinStride;
+		size_t				mAlignment;
+		//! Offsets within a record, for interleaved layouts.
+		size_t				mOffsets[ 3 ];
+		size_t				mStride;
+	};
+
+	/*! Writes \a primitive in a single pass into caller-provided arrays sized 
+		with calcSize(). Pass null to skip an attribute. Other than icospheres, 
+		primitives only allocate a sine and cosine table for a segment count not 
+		in the 1 MB table cache, either on first use, after eviction, or every 
+		time for a table bigger than the cache. Icospheres subdivide into scratch 
+		vectors on every call. The first threaded call starts a shared pool of 
+		worker threads, and threaded calls may grow the pool's task list. Large 
+		planes are split into bands of rows across up to \a numThreads threads, 
+		or one per core when zero. Output does not depend on thread count. 
+		\a tangents receives a unit tangent per vertex pointing the way the first 
+		texture coordinate increases, for normal mapping, when not null. Its w is 
+		1.0, or -1.0 where the texture is mirrored, so the bitangent is 
+		normal.cross( tangent.xyz() ) * tangent.w. Tangents come straight from 
+		the shape, except on icospheres, where they are found from the triangles 
+		as by calcTangents(). With SSE or AVX, meshes over 8 MB are written with 
+		stores that bypass the cache, since they would not stay in it anyway. */
+	static void				generate( const Primitive &primitive, uint32_t *indices, ci::Vec3f *positions, 
+								ci::Vec3f *normals, ci::Vec2f *texCoords, uint32_t numThreads = 0, 
+								ci::Vec4f *tangents = 0 );
+
+	/*! Writes \a primitive into caller-provided vertex data arranged as \a layout 
+		and sized with VertexLayout::getDataSize(). Pass null \a indices to skip them. 
+		Compressed attributes are generated at full precision into scratch memory, 
+		then encoded with SIMD on up to \a numThreads threads. */
+	static void				generate( const Primitive &primitive, uint32_t *indices, void *vertexData, 
+								const VertexLayout &layout, uint32_t numThreads = 0 );
+
+	/*! Create TriMesh from \a primitive, generated directly into preallocated mesh storage. 
+		A tangent per vertex is written into \a tangents when not null, as by generate(). */
+	static ci::TriMesh		createTriMesh( const Primitive &primitive, uint32_t numThreads = 0, 
+								std::vector<ci::Vec4f> *tangents = 0 );
+	//! Create TriMesh from vectors of vertex data. The vectors are copied in bulk.
+	static ci::TriMesh		createTriMesh( std::vector<uint32_t> &indices, const std::vector<ci::Vec3f> &positions,
+								const std::vector<ci::Vec3f> &normals, const std::vector<ci::Vec2f> &texCoords );
+	/*! Create TriMesh that takes over the storage of the vectors of vertex data 
+		without copying. The vectors are left empty. */
+	static ci::TriMesh		adoptTriMesh( std::vector<uint32_t> &indices, std::vector<ci::Vec3f> &positions,
+								std::vector<ci::Vec3f> &normals, std::vector<ci::Vec2f> &texCoords );
+
+	//! Index widths for staging buffers.
+	typedef enum
+	{
+		/*! 16-bit when there are fewer than 65536 vertices, otherwise 32-bit. 
+			Index 0xffff is never used, leaving it free for primitive restart. */
+		INDEX_AUTO, 
+		//! 16-bit when the vertex count allows, as for INDEX_AUTO, otherwise 32-bit.
+		INDEX_UINT16, 
+		INDEX_UINT32
+	} IndexFormat;
+
+	/*! CPU-side vertex and index data in the final layout of a gl::VboMesh, 
+		with the vertex attributes arranged as a VertexLayout in one block. 
+		Uploading is a single copy per buffer. Needs no GL context. */
+	class StagingBuffer
+	{
+	public:
+		StagingBuffer();
+
+		size_t				getNumVertices() const { return mNumVertices; }
+		size_t				getNumIndices() const { return mNumIndices; }
+		const VertexLayout&	getLayout() const { return mLayout; }
+		
+		//! INDEX_UINT16 or INDEX_UINT32.
+		IndexFormat			getIndexFormat() const { return mIndexFormat; }
+		//! Indices of getIndexFormat() width.
+		const uint8_t*		getIndexData() const { return mIndexData.empty() ? 0 : &mIndexData[ 0 ]; }
+		size_t				getIndexDataSize() const { return mIndexData.size(); }
+		//! Reads back index \a i, whatever its width.
+		uint32_t			getIndex( size_t i ) const;
+		Topology			getTopology() const { return mTopology; }
+		//! Index separating strips with TOPOLOGY_STRIP_RESTART, all ones at getIndexFormat() width.
+		uint32_t			getRestartIndex() const { return mIndexFormat == INDEX_UINT16 ? 0xffff : 0xffffffff; }
+
+		const uint8_t*		getVertexData() const { return mVertexData.empty() ? 0 : &mVertexData[ 0 ]; }
+		//! Size of the vertex block in bytes.
+		size_t				getVertexDataSize() const { return mVertexData.size(); }
+		
+		//! Byte offset of the first \a attrib within the vertex block.
+		size_t				getOffset( VertexLayout::Attrib attrib ) const { return mLayout.getOffset( attrib, mNumVertices ); }
+		size_t				getStride( VertexLayout::Attrib attrib ) const { return mLayout.getStride( attrib ); }
+
+		/*! Bounds FORMAT_UNORM16 positions are quantized to. A value decodes as 
+			min + ( max - min ) * value, with value normalized to [ 0, 1 ]. */
+		const ci::AxisAlignedBox3f&	getPositionBounds() const { return mPositionBounds; }
+
+		//! Reads back and decodes the attributes of vertex \a i, whatever the layout.
+		ci::Vec3f			getPosition( size_t i ) const;
+		ci::Vec3f			getNormal( size_t i ) const;
+		ci::Vec2f			getTexCoord( size_t i ) const;
+	private:
+		friend class		MeshHelper;
+
+		const uint8_t*		getAttrib( VertexLayout::Attrib attrib, size_t i ) const;
+
+		size_t					mNumVertices;
+		size_t					mNumIndices;
+		VertexLayout			mLayout;
+		ci::AxisAlignedBox3f	mPositionBounds;
+		IndexFormat				mIndexFormat;
+		Topology				mTopology;
+		std::vector<uint8_t>	mIndexData;
+		std::vector<uint8_t>	mVertexData;
+	};
+
+	/*! Generates \a primitive straight into a StagingBuffer arranged as \a layout, 
+		with indices of \a indexFormat, without building a TriMesh first. Threading 
+		is as for generate(). Strip topologies write one strip per row of grids 
+		such as planes, sphere bands and cylinder sides, and zigzag strips across 
+		caps and circles, leaving their center vertices unused. */
+	static StagingBuffer	createStagingBuffer( const Primitive &primitive, const VertexLayout &layout = VertexLayout(), 
+								IndexFormat indexFormat = INDEX_AUTO, Topology topology = TOPOLOGY_TRIANGLES, 
+								uint32_t numThreads = 0 );
+	/*! Create TriMesh by decoding every vertex in \a buffer. Strips are expanded 
+		into triangles, dropping the degenerate ones. */
+	static ci::TriMesh		createTriMesh( const StagingBuffer &buffer );
+
+	/*! Levels of detail for a primitive, from full detail down, sharing the vertices 
+		of the most detailed level. Each level is a range of the index buffer, drawn 
+		with gl::drawRange() on a VboMesh of getTriMesh(). */
+	class LodChain
+	{
+	public:
+		class Level
+		{
+		public:
+			Level();
+
+			//! Parameters of the primitive this level approximates the full detail one with.
+			const Primitive&	getPrimitive() const { return mPrimitive; }
+			size_t				getIndexOffset() const { return mIndexOffset; }
+			size_t				getNumIndices() const { return mNumIndices; }
+			size_t				getNumTriangles() const { return mNumIndices / 3; }
+			/*! Largest distance between this level and the exact surface it approximates, 
+				in object space. */
+			float				getError() const { return mError; }
+		private:
+			friend class		MeshHelper;
+
+			Primitive			mPrimitive;
+			size_t				mIndexOffset;
+			size_t				mNumIndices;
+			float				mError;
+		};
+
+		size_t					getNumLevels() const { return mLevels.size(); }
+		//! Level \a i, where zero is full detail.
+		const Level&			getLevel( size_t i ) const { return mLevels[ i ]; }
+		//! Vertices of the full detail level, and the indices of every level in order.
+		const ci::TriMesh&		getTriMesh() const { return mMesh; }
+	private:
+		friend class			MeshHelper;
+
+		std::vector<Level>		mLevels;
+		ci::TriMesh				mMesh;
+	};
+
+	/*! Generates up to \a numLevels levels of detail for \a primitive, or as many as 
+		possible when zero. Each level halves the segment count, the ring count of spheres 
+		and tori, and the layer count of cones and cylinders when it is even, while the 
+		halves stay whole and the shape stays closed, or removes a subdivision from 
+		icospheres, so its vertices are a subset of the full detail level. Every type has 
+		levels, except cubes with an odd subdivision count. Threading is as for generate(). */
+	static LodChain			createLodChain( const Primitive &primitive, uint32_t numLevels = 0, uint32_t numThreads = 0 );
+
+	typedef std::shared_ptr<const ci::TriMesh> TriMeshRef;
+
+	/*! Returns a shared, immutable TriMesh for \a primitive from the primitive cache, 
+		generating and caching it on a miss. Safe to call from any thread. */
+	static TriMeshRef		getTriMesh( const Primitive &primitive );
+	/*! Sets the byte budget of the primitive cache. Least recently used meshes 
+		are evicted once the budget is exceeded. Defaults to 32MB. */
+	static void				setCacheBudget( size_t bytes );
+	static size_t			getCacheBudget();
+	//! Returns the number of bytes held by the primitive cache.
+	static size_t			getCacheSize();
+	static size_t			getCacheHitCount();
+	static size_t			getCacheMissCount();
+	/*! Empties the primitive cache and resets its hit and miss counts. Also drops 
+		the sine and cosine tables kept for recently used segment counts. */
+	static void				clearCache();
+
+	/*! Generates \a primitives concurrently on up to \a numThreads threads, or 
+		one per core when zero. Results are returned in input order. Identical 
+		descriptors are only generated once and share a mesh. */
+	static std::vector<TriMeshRef>	createTriMeshes( const std::vector<Primitive> &primitives, uint32_t numThreads = 0 );
+
+	//! A primitive or a TriMesh placed in a batch by a transform.
+	class BatchSource
+	{
+	public:
+		BatchSource( const Primitive &primitive, const ci::Matrix44f &transform = ci::Matrix44f() );
+		//! \a mesh is referenced rather than copied, and must outlive createBatch().
+		BatchSource( const ci::TriMesh &mesh, const ci::Matrix44f &transform = ci::Matrix44f() );
+
+		const Primitive&		getPrimitive() const { return mPrimitive; }
+		//! The referenced mesh, or null when the source is a primitive.
+		const ci::TriMesh*		getTriMesh() const { return mMesh; }
+		const ci::Matrix44f&	getTransform() const { return mTransform; }
+	private:
+		Primitive				mPrimitive;
+		const ci::TriMesh		*mMesh;
+		ci::Matrix44f			mTransform;
+	};
+
+	/*! Sources merged into one mesh, so many small objects take a single draw call. 
+		Each source keeps the range of indices it became, which can still be drawn 
+		on its own with gl::drawRange() on a VboMesh of getTriMesh(). */
+	class Batch
+	{
+	public:
+		class Range
+		{
+		public:
+			Range();
+
+			size_t				getIndexOffset() const { return mIndexOffset; }
+			size_t				getNumIndices() const { return mNumIndices; }
+			size_t				getNumTriangles() const { return mNumIndices / 3; }
+			size_t				getVertexOffset() const { return mVertexOffset; }
+			size_t				getNumVertices() const { return mNumVertices; }
+		private:
+			friend class		MeshHelper;
+
+			size_t				mIndexOffset;
+			size_t				mNumIndices;
+			size_t				mVertexOffset;
+			size_t				mNumVertices;
+		};
+
+		size_t					getNumRanges() const { return mRanges.size(); }
+		//! Range of source \a i, in the order the sources were given.
+		const Range&			getRange( size_t i ) const { return mRanges[ i ]; }
+		const ci::TriMesh&		getTriMesh() const { return mMesh; }
+	private:
+		friend class			MeshHelper;
+
+		std::vector<Range>		mRanges;
+		ci::TriMesh				mMesh;
+	};
+
+	/*! Merges \a sources into one triangle list, in order. Positions are moved by the 
+		affine part of each source's transform, and normals by its inverse transpose, 
+		then normalized. Sources with a mirroring transform have their triangles 
+		turned around so they keep facing out. Normals and texture coordinates are 
+		kept when every source has them. Identical primitives are generated once, 
+		then sources are merged concurrently on up to \a numThreads threads, or one 
+		per core when zero. */
+	static Batch			createBatch( const std::vector<BatchSource> &sources, uint32_t numThreads = 0 );
+
+	/*! Create circle TriMesh with a radius of 1.0 and \a segments. This and the 
+		following methods write a tangent per vertex into \a tangents when not null, 
+		as createTriMesh() does. */
+	static ci::TriMesh		createCircleTriMesh( uint32_t segments = 12, std::vector<ci::Vec4f> *tangents = 0 );
+	/*! Create cone TriMesh with a radius and height of 1.0 and \a segments. 
+		Base is closed when \a closeBase is set to true. The side is split 
+		into \a layers bands from base to apex. */
+	static ci::TriMesh		createConeTriMesh( uint32_t segments = 12, bool closeBase = true, uint32_t layers = 1, 
+		uint32_t numThreads = 0, std::vector<ci::Vec4f> *tangents = 0 );
+	/*! Create cube TriMesh with an edge length of 1.0, with each face a grid 
+		of \a subdivisions by \a subdivisions quads. Faces keep their own 
+		vertices along the edges, so their normals stay flat. */
+	static ci::TriMesh		createCubeTriMesh( uint32_t subdivisions = 1, uint32_t numThreads = 0, 
+		std::vector<ci::Vec4f> *tangents = 0 );
+	/*! Create cylinder TriMesh with a height of 1.0, top radius of \a topRadius, base radius 
+		of \a baseRadius and \a segments. Top and base are closed with \a closeTop and 
+		\a closeBase flags. The side is split into \a layers bands from base to top. 
+		Subdivided cubes, cones and cylinders are generated in bands like planes, on up 
+		to \a numThreads threads, or one per core when zero. */
+	static ci::TriMesh		createCylinderTriMesh( uint32_t segments = 12, float topRadius = 1.0f, 
+		float baseRadius = 1.0f, bool closeTop = true, bool closeBase = true, uint32_t layers = 1, 
+		uint32_t numThreads = 0, std::vector<ci::Vec4f> *tangents = 0 );
+	/*! Create ring TriMesh with a radius of 1.0, \a segments, and second radius 
+	 of \a v. */
+	static ci::TriMesh		createRingTriMesh( uint32_t segments = 12, float secondRadius = 0.5f, 
+		std::vector<ci::Vec4f> *tangents = 0 );
+	/*! Create sphere TriMesh with a radius of 1.0, \a segments around the poles and 
+		\a rings from pole to pole. Rings defaults to half the segment count. */
+	static ci::TriMesh		createSphereTriMesh( uint32_t segments, uint32_t rings = 0, std::vector<ci::Vec4f> *tangents = 0 );
+	/*! Create square TriMesh with an edge length of 1.0, with \a hSegments and \a vSegments 
+		vertices along its edges, at least two each. Large planes are generated in bands 
+		on up to \a numThreads threads, or one per core when zero. */
+	static ci::TriMesh		createPlaneTriMesh( uint32_t hSegments = 2, uint32_t vSegments = 2, uint32_t numThreads = 0, 
+		std::vector<ci::Vec4f> *tangents = 0 );
+	/*! Create icosphere TriMesh with a radius of 1.0, made by splitting each face of 
+		an icosahedron into four \a subdivisions times, giving 20 * 4 ^ subdivisions 
+		triangles of near equal size. Texture coordinates follow a net of the 
+		icosahedron, five columns of four faces, with its poles on the Z axis. */
+	static ci::TriMesh		createIcosphereTriMesh( uint32_t subdivisions = 2, std::vector<ci::Vec4f> *tangents = 0 );
+	/*! Create torus TriMesh around the Z axis, with a tube of \a minorRadius and 
+		\a minorSegments running \a majorSegments around a circle of \a majorRadius. 
+		Large tori are generated in bands on up to \a numThreads threads, or one per 
+		core when zero. */
+	static ci::TriMesh		createTorusTriMesh( uint32_t majorSegments = 24, uint32_t minorSegments = 12, 
+		float majorRadius = 1.0f, float minorRadius = 0.25f, uint32_t numThreads = 0, 
+		std::vector<ci::Vec4f> *tangents = 0 );
+
+	/*! Average cache miss ratio of \a indices, a triangle list referring to \a numVertices 
+		vertices: the number of vertices transformed per triangle with a FIFO post-transform 
+		cache of \a cacheSize entries. Ranges from 3.0 down to about 0.5 for large grids. */
+	static float			calcAcmr( const std::vector<uint32_t> &indices, size_t numVertices, uint32_t cacheSize = 16 );
+	/*! Reorders the triangles of \a indices, a triangle list referring to \a numVertices 
+		vertices, so vertices are reused from a post-transform cache of \a cacheSize entries. 
+		Uses the Tipsify algorithm, which runs in time linear in the index count. Returns 
+		the ACMR after reordering. */
+	static float			optimizeVertexCache( std::vector<uint32_t> &indices, size_t numVertices, uint32_t cacheSize = 16 );
+	//! Reorders the triangles of \a mesh as for optimizeVertexCache(). Returns the ACMR after reordering.
+	static float			optimizeVertexCache( ci::TriMesh &mesh, uint32_t cacheSize = 16 );
+	/*! Reorders vertices into the order \a indices first use them, drops vertices no index 
+		uses, and remaps \a indices to match. Run after optimizeVertexCache() so vertices are 
+		fetched in sequence. Each attribute vector holding a value per vertex is reordered 
+		with the positions. Returns the new vertex count. */
+	static size_t			optimizeVertexFetch( std::vector<uint32_t> &indices, std::vector<ci::Vec3f> &positions, 
+									std::vector<ci::Vec3f> &normals, std::vector<ci::Vec2f> &texCoords );
+	//! Reorders and compacts the vertices of \a mesh, colors included, as for optimizeVertexFetch().
+	static size_t			optimizeVertexFetch( ci::TriMesh &mesh );
+	/*! Merges vertices whose positions, normals and texture coordinates are each within 
+		\a positionEpsilon, \a normalEpsilon and \a texCoordEpsilon of an earlier vertex on every 
+		axis, and remaps \a indices. Empty attribute vectors are ignored. Vertices are looked up 
+		in a spatial hash of cells eight times \a positionEpsilon wide, so welding takes expected 
+		linear time, split across up to \a numThreads threads, or one per core when zero. Merges chain, 
+		so vertices within tolerance of a merged vertex join it too. Returns the new vertex count. */
+	static size_t			weldVertices( std::vector<uint32_t> &indices, std::vector<ci::Vec3f> &positions, 
+									std::vector<ci::Vec3f> &normals, std::vector<ci::Vec2f> &texCoords, 
+									float positionEpsilon = 1e-5f, float normalEpsilon = 1e-3f, 
+									float texCoordEpsilon = 1e-5f, uint32_t numThreads = 0 );
+	//! Welds the vertices of \a mesh as for weldVertices(). Colors are kept from the first vertex of each weld.
+	static size_t			weldVertices( ci::TriMesh &mesh, float positionEpsilon = 1e-5f, float normalEpsilon = 1e-3f, 
+									float texCoordEpsilon = 1e-5f, uint32_t numThreads = 0 );
+	/*! Simplifies \a mesh by collapsing edges until it has at most \a targetTriangles 
+		triangles, or the cheapest collapse left would cost more than \a maxError. Collapses 
+		are ordered by quadric error, the root mean squared distance of the moved vertex from 
+		the planes of the triangles merged into it, combined with the change in normal and 
+		texture coordinate scaled by \a attributeWeight times the bounding box diagonal. 
+		Vertices move onto a neighbor, so vertices kept keep their attributes. Vertices on 
+		normal or texture seams stay in place, and borders are only shortened along 
+		themselves. Quadrics and first collapses are found on up to \a numThreads threads, 
+		or one per core when zero. Unused vertices are dropped as by optimizeVertexFetch(). 
+		Returns the cost of the most expensive collapse made. */
+	static float			simplify( ci::TriMesh &mesh, size_t targetTriangles, float maxError = FLT_MAX, 
+									float attributeWeight = 0.05f, uint32_t numThreads = 0 );
+
+	//! How calcNormals() weighs the normals of the triangles around a vertex.
+	typedef enum
+	{
+		//! By triangle area. Cheapest, and suits evenly tessellated meshes.
+		NORMAL_WEIGHT_AREA, 
+		//! By the angle of the triangle at the vertex, which does not depend on how faces are split into triangles.
+		NORMAL_WEIGHT_ANGLE
+	} NormalWeight;
+
+	/*! Computes smooth normals for the triangle list \a indices into \a normals, one per 
+		vertex of \a positions. Each is the normalized sum of the normals of the triangles 
+		using the vertex, weighted by \a weight. Vertices no triangle uses get a zero normal. 
+		Triangles are split into a slice per thread, on up to \a numThreads threads or one 
+		per core when zero, each summing into its own buffer, and the buffers are then added 
+		up and normalized in parallel. The last bits of the result may vary with the thread 
+		count, but not between runs. */
+	static void				calcNormals( const std::vector<uint32_t> &indices, const std::vector<ci::Vec3f> &positions, 
+									std::vector<ci::Vec3f> &normals, NormalWeight weight = NORMAL_WEIGHT_AREA, 
+									uint32_t numThreads = 0 );
+	//! Replaces the normals of \a mesh with smooth normals, as for calcNormals().
+	static void				calcNormals( ci::TriMesh &mesh, NormalWeight weight = NORMAL_WEIGHT_AREA, uint32_t numThreads = 0 );
+	/*! Computes a tangent for normal mapping into \a tangents for each vertex of the triangle 
+		list \a indices, as generate() writes for primitives. Each is the direction the first 
+		texture coordinate increases in, summed over the triangles using the vertex weighted by 
+		their area in texture space, made perpendicular to its normal and normalized. Its w is the 
+		handedness of the summed directions of the second texture coordinate. Where the texture doesn't vary, 
+		any direction perpendicular to the normal is used. \a tangents is left empty unless there 
+		is a normal and texture coordinate for every position. Threading is as for calcNormals(). */
+	static void				calcTangents( const std::vector<uint32_t> &indices, const std::vector<ci::Vec3f> &positions, 
+									const std::vector<ci::Vec3f> &normals, const std::vector<ci::Vec2f> &texCoords, 
+									std::vector<ci::Vec4f> &tangents, uint32_t numThreads = 0 );
+	//! Computes tangents for \a mesh into \a tangents, as for calcTangents().
+	static void				calcTangents( const ci::TriMesh &mesh, std::vector<ci::Vec4f> &tangents, uint32_t numThreads = 0 );
+
+#if ! defined( CINDER_COCOA_TOUCH )
+	/*! Create VboMesh from a StagingBuffer. Uncompressed buffers that are planar, 
+		or packed in position, normal, texture coordinate order, are uploaded with 
+		one copy per buffer. Other layouts are decoded first, as gl::VboMesh can't 
+		describe them. gl::VboMesh only draws 32-bit indices, so 16-bit indices are 
+		widened, restart indices included. Strip topologies are drawn as 
+		GL_TRIANGLE_STRIP. */
+	static ci::gl::VboMesh	createVboMesh( const StagingBuffer &buffer );
+	//! Create VboMesh from a TriMesh.
+	static ci::gl::VboMesh	createVboMesh( const ci::TriMesh &mesh, GLenum primitiveType = GL_TRIANGLES );
+	//! Create VboMesh from vectors of vertex data.
+	static ci::gl::VboMesh	createVboMesh( const std::vector<uint32_t> &indices, const std::vector<ci::Vec3f> &positions, 
+								const std::vector<ci::Vec3f> &normals, const std::vector<ci::Vec2f> &texCoords, 
+								GLenum primitiveType = GL_TRIANGLES );
+	
+	//! Create circle VboMesh with a radius of 1.0 and \a segments.
+	static ci::gl::VboMesh	createCircleVboMesh( uint32_t segments = 12 );
+	/*! Create cone VboMesh with a radius and height of 1.0 and \a segments. 
+		Base is closed when \a closeBase is set to true. The side is split 
+		into \a layers bands from base to apex. */
+	static ci::gl::VboMesh	createConeVboMesh( uint32_t segments = 12, bool closeBase = true, uint32_t layers = 1 );
+	/*! Create cube VboMesh with an edge length of 1.0, with each face a grid 
+		of \a subdivisions by \a subdivisions quads. */
+	static ci::gl::VboMesh	createCubeVboMesh( uint32_t subdivisions = 1 );
+	/*! Create cylinder VboMesh with a height of 1.0, top radius of \a topRadius, base radius 
+		of \a baseRadius and \a segments. Top and base are closed with \a closeTop and 
+		\a closeBase flags. The side is split into \a layers bands from base to top. */
+	static ci::gl::VboMesh	createCylinderVboMesh( uint32_t segments = 12, float topRadius = 1.0f, 
+		float baseRadius = 1.0f, bool closeTop = true, bool closeBase = true, uint32_t layers = 1 );
+	/*! Create ring VboMesh with a radius of 1.0, \a segments, and a second radius .
+	 of \a secondRadius. */
+	static ci::gl::VboMesh	createRingVboMesh( uint32_t segments = 12, float secondRadius = 0.5f );
+	/*! Create sphere VboMesh with a radius of 1.0, \a segments around the poles and 
+		\a rings from pole to pole. Rings defaults to half the segment count. */
+	static ci::gl::VboMesh	createSphereVboMesh( uint32_t segments = 12, uint32_t rings = 0 );
+	//! Create square VboMesh with an edge length of 1.0.
+	static ci::gl::VboMesh	createPlaneVboMesh( uint32_t hSegments = 2, uint32_t vSegments = 2 );
+	/*! Create icosphere VboMesh with a radius of 1.0, made by splitting each face of 
+		an icosahedron into four \a subdivisions times. */
+	static ci::gl::VboMesh	createIcosphereVboMesh( uint32_t subdivisions = 2 );
+	/*! Create torus VboMesh around the Z axis, with a tube of \a minorRadius and 
+		\a minorSegments running \a majorSegments around a circle of \a majorRadius. */
+	static ci::gl::VboMesh	createTorusVboMesh( uint32_t majorSegments = 24, uint32_t minorSegments = 12, 
+		float majorRadius = 1.0f, float minorRadius = 0.25f );
+#endif
+};